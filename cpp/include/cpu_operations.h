@@ -25,16 +25,94 @@
 
 #include <string>
 #include <iostream>
+#include <vector>
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <limits>
+#include <functional>
+#include <thread>  // NOLINT(build/c++11)
 #include "include/matrix.h"
 #include "include/vector.h"
 #include "include/kernel_types.h"
+#include "Eigen/Dense"
 #include "Eigen/SVD"
 #include "include/svd_solver.h"
 #include "include/util.h"
 
 namespace Nice {
 
+// The factorizations of CpuOperations::Solver
+enum Factorization {
+  kAutoFactorization = 0,
+  kLuFactorization,
+  kCholeskyFactorization,
+  kQrFactorization
+};
+
+// The p of CpuOperations::Norm for the maximum norm
+const int kInfinityNorm = -1;
+
+// The running mean and population variance of the columns of a stream of
+// sample blocks, one sample per row. Each block is reduced on its own and
+// merged into the totals with the update of Chan et al., which is stable
+// and lets the blocks come from different threads or chunks of a stream.
+template<typename T>
+class RunningMeanVariance {
+ public:
+  RunningMeanVariance() : count_(0) {}
+
+  // Adds the rows of block as samples
+  template<typename Derived>
+  void Add(const Eigen::MatrixBase<Derived> &block) {
+    if (block.rows() == 0)
+      return;
+    RunningMeanVariance<T> other;
+    other.count_ = block.rows();
+    other.mean_ = block.colwise().mean().transpose();
+    other.m2_ = (block.rowwise() - other.mean_.transpose()).colwise()
+        .squaredNorm().transpose();
+    Merge(other);
+  }
+
+  // Adds the samples of other
+  void Merge(const RunningMeanVariance<T> &other) {
+    if (other.count_ == 0)
+      return;
+    if (count_ == 0) {
+      *this = other;
+      return;
+    }
+    if (other.mean_.size() != mean_.size()) {
+      std::cerr << "SAMPLES ARE NOT THE SAME SIZE!";
+      exit(1);
+    }
+    int64_t total = count_ + other.count_;
+    Vector<T> delta = other.mean_ - mean_;
+    mean_ += delta * (T(other.count_) / total);
+    m2_ += other.m2_ + delta.cwiseAbs2() * (T(count_) * other.count_ / total);
+    count_ = total;
+  }
+
+  int64_t Count() const {
+    return count_;
+  }
+
+  Vector<T> Mean() const {
+    return mean_;
+  }
+
+  Vector<T> Variance() const {
+    return m2_ / T(count_);
+  }
+
+ private:
+  int64_t count_;
+  Vector<T> mean_;
+  // The sums of the squared deviations from the mean
+  Vector<T> m2_;
+};
+
 // Abstract class of common matrix operation interface
 template<typename T>
 class CpuOperations {
@@ -63,6 +141,18 @@ class CpuOperations {
     return a.transpose();
   }
 
+  /// Writes the transpose of a into result, which must not alias a
+  template<typename A, typename Out>
+  static void Transpose(const Eigen::MatrixBase<A> &a,
+                        Eigen::MatrixBase<Out> *result) {
+    result->derived() = a.transpose();
+  }
+
+  /// Transposes a in place
+  static void Transpose(Matrix<T> *a) {
+    a->transposeInPlace();
+  }
+
   /// This is a function that calculates the product Matrix of the input Matrix
   /// and a scalar
   ///
@@ -78,6 +168,13 @@ class CpuOperations {
     return scalar * a;
   }
 
+  /// Writes scalar * a into result, which may be a itself
+  template<typename A, typename Out>
+  static void Multiply(const Eigen::MatrixBase<A> &a, const T &scalar,
+                       Eigen::MatrixBase<Out> *result) {
+    result->derived() = scalar * a;
+  }
+
   /// This is a funtion that calculates the product Matrix of the two input
   /// Matrices
   ///
@@ -92,6 +189,18 @@ class CpuOperations {
     // Matrix-matrix multiplication
     return a * b;
   }
+
+  /// Writes a * b into result, which must not alias a or b
+  template<typename A, typename B, typename Out>
+  static void Multiply(const Eigen::MatrixBase<A> &a,
+                       const Eigen::MatrixBase<B> &b,
+                       Eigen::MatrixBase<Out> *result) {
+    if (a.cols() != b.rows()) {
+      std::cerr << "MATRICES ARE NOT THE SAME SIZE!";
+      exit(1);
+    }
+    result->derived().noalias() = a * b;
+  }
   /// This is a function that adds each element in the matrix to a scalar and
   /// returns the resulting matrix.
   ///
@@ -107,15 +216,21 @@ class CpuOperations {
   /// \sa
   /// \ref Add(const Matrix<T> &a, const Matrix<T> &b)
   static Matrix<T> Add(const Matrix<T> &a, const T &scalar) {
+    Matrix<T> result;
+    Add(a, scalar, &result);
+    return result;
+  }
+
+  /// Writes a + scalar into result, which may be a itself
+  template<typename A, typename Out>
+  static void Add(const Eigen::MatrixBase<A> &a, const T &scalar,
+                  Eigen::MatrixBase<Out> *result) {
     // Does not work if matrix is empty.
     if (a.rows() == 0) {
       std::cerr << "MATRICIES ARE EMPTY";
       exit(1);
-
-      // Otherwise, code will run fine.
-    } else {
-      return (a.array() + scalar);
     }
+    result->derived() = (a.array() + scalar).matrix();
   }
   /// This is a function that adds two matricies and returns the resulting
   /// matrix.
@@ -132,6 +247,15 @@ class CpuOperations {
   /// \sa
   /// \ref Add(const Matrix<T> &a, const T &scalar)
   static Matrix<T> Add(const Matrix<T> &a, const Matrix<T> &b) {
+    Matrix<T> result;
+    Add(a, b, &result);
+    return result;
+  }
+
+  /// Writes a + b into result, which may be a or b
+  template<typename A, typename B, typename Out>
+  static void Add(const Eigen::MatrixBase<A> &a, const Eigen::MatrixBase<B> &b,
+                  Eigen::MatrixBase<Out> *result) {
     // Does not work if matricies are not the same size.
     if ((a.rows() != b.rows()) || (a.cols() != b.cols())) {
       std::cerr << "MATRICIES ARE NOT THE SAME SIZE";
@@ -141,11 +265,8 @@ class CpuOperations {
     } else if (a.rows() == 0) {
       std::cerr << "MATRICIES ARE EMPTY";
       exit(1);
-
-      // Otherwise, code will run fine.
-    } else {
-      return a + b;
     }
+    result->derived() = a + b;
   }
   /// This is a function that subtracts a scalar from a matrix and returns
   /// the resulting matrix.
@@ -162,12 +283,21 @@ class CpuOperations {
   /// \sa
   /// \ref Subtract(const Matrix<T> &a, const Matrix<T> &b)
   static Matrix<T> Subtract(const Matrix<T> &a, const T &scalar) {
+    Matrix<T> result;
+    Subtract(a, scalar, &result);
+    return result;
+  }
+
+  /// Writes a - scalar into result, which may be a itself
+  template<typename A, typename Out>
+  static void Subtract(const Eigen::MatrixBase<A> &a, const T &scalar,
+                       Eigen::MatrixBase<Out> *result) {
     // Does not work if matrix is empty.
     if (a.rows() == 0 || a.cols() == 0) {
       std::cerr << "SUBTRACT: EMPTY MATRIX AS ARGUEMENT!";
       exit(1);
     }
-    return (a.array() - scalar);
+    result->derived() = (a.array() - scalar).matrix();
   }
   /// This is a function that subtracts two matricies and returns the resulting
   /// matrix.
@@ -184,6 +314,16 @@ class CpuOperations {
   /// \sa
   /// \ref Add(const Matrix<T> &a, const T &scalar)
   static Matrix<T> Subtract(const Matrix<T> &a, const Matrix<T> &b) {
+    Matrix<T> result;
+    Subtract(a, b, &result);
+    return result;
+  }
+
+  /// Writes a - b into result, which may be a or b
+  template<typename A, typename B, typename Out>
+  static void Subtract(const Eigen::MatrixBase<A> &a,
+                       const Eigen::MatrixBase<B> &b,
+                       Eigen::MatrixBase<Out> *result) {
     // Does not work if matricies are not the same size.
     if ((a.rows() != b.rows()) || (a.cols() != b.cols())) {
       std::cerr << "MATRICES ARE NOT THE SAME SIZE!";
@@ -194,7 +334,7 @@ class CpuOperations {
       std::cerr << "SUBTRACT: EMPTY MATRIX AS ARGUMENT!";
       exit(1);  // Exits the program
     }
-    return a - b;
+    result->derived() = a - b;
   }
 
   /// This is a function that calculates the "logical or" of the two input
@@ -208,6 +348,16 @@ class CpuOperations {
   /// \return
   /// This function returns a Matrix of type bool
   static Matrix<bool> LogicalOr(const Matrix<bool> &a, const Matrix<bool> &b) {
+    Matrix<bool> result;
+    LogicalOr(a, b, &result);
+    return result;
+  }
+
+  /// Writes the "logical or" of a and b into result, which may be a or b
+  template<typename A, typename B, typename Out>
+  static void LogicalOr(const Eigen::MatrixBase<A> &a,
+                        const Eigen::MatrixBase<B> &b,
+                        Eigen::MatrixBase<Out> *result) {
     // Returns the resulting matrix that is created by running a logical or
     // operation on the two input matrices
     if ((a.rows() != b.rows()) || (a.cols() != b.cols())) {
@@ -218,7 +368,7 @@ class CpuOperations {
       std::cerr << "EMPTY MATRIX AS ARGUMENT!";
       exit(1);  // Exits the program
     }
-    return (a.array() || b.array());
+    result->derived() = (a.array() || b.array()).matrix();
   }
 
   /// This is a funtion that returns the "logical not" of the input Matrix
@@ -229,19 +379,20 @@ class CpuOperations {
   /// \return
   /// This funtion returns a Matrix of type bool
   static Matrix<bool> LogicalNot(const Matrix<bool> &a) {
-    Matrix<bool> b = a.replicate(1, 1);
-    int r;
-    // Iterate through the copied matrix
-    for (r = 0; r < b.rows(); ++r) {
-      for (int c = 0; c < b.cols(); ++c) {
-        b(r, c) = !b(r, c);
-      }
-    }
-    if (b.rows() == 0 || b.cols() == 0) {
+    Matrix<bool> b;
+    LogicalNot(a, &b);
+    return b;
+  }
+
+  /// Writes the "logical not" of a into result, which may be a itself
+  template<typename A, typename Out>
+  static void LogicalNot(const Eigen::MatrixBase<A> &a,
+                         Eigen::MatrixBase<Out> *result) {
+    if (a.rows() == 0 || a.cols() == 0) {
       std::cerr << "EMPTY MATRIX AS ARGUMENT!";
       exit(1);  // Exits the program
     }
-    return b;
+    result->derived() = a.unaryExpr(std::logical_not<bool>());
   }
 
   /// This is a function that calculates the "logical and" of the two input
@@ -255,15 +406,163 @@ class CpuOperations {
   /// \return
   /// This function returns a Matrix of type bool
   static Matrix<bool> LogicalAnd(const Matrix<bool> &a, const Matrix<bool> &b) {
+    Matrix<bool> result;
+    LogicalAnd(a, b, &result);
+    return result;
+  }
+
+  /// Writes the "logical and" of a and b into result, which may be a or b
+  template<typename A, typename B, typename Out>
+  static void LogicalAnd(const Eigen::MatrixBase<A> &a,
+                         const Eigen::MatrixBase<B> &b,
+                         Eigen::MatrixBase<Out> *result) {
     // Checks to see that the number of rows and columns are the same
     if ((a.rows() != b.rows()) || (a.cols() != b.cols())) {
       std::cerr << "MATRICES ARE NOT THE SAME SIZE!";
       exit(1);  // Exits the program
     }
-    return (a.array() && b.array());
-    // Will return a matrix due to implicit conversion
+    result->derived() = (a.array() && b.array()).matrix();
   }
 
+  /// A factorization of a matrix A that is computed once and reused to
+  /// solve A X = B for many right hand sides, without forming the inverse.
+  /// By default a symmetric positive definite matrix is factored with
+  /// Cholesky (LLT), any other square matrix with partially pivoted LU, and
+  /// a rectangular one with column pivoted QR, which solves in the least
+  /// squares sense. A Cholesky request on a matrix that is not positive
+  /// definite falls back to LU.
+  class Solver {
+   public:
+    explicit Solver(const Matrix<T> &a,
+                    const Factorization factorization = kAutoFactorization)
+        : rows_(a.rows()), cols_(a.cols()) {
+      if (a.rows() == 0 || a.cols() == 0) {
+        std::cerr << "MATRIX IS EMPTY";
+        exit(1);
+      }
+      factorization_ = factorization;
+      if (factorization_ == kAutoFactorization) {
+        if (a.rows() != a.cols())
+          factorization_ = kQrFactorization;
+        else if (a.isApprox(a.transpose()))
+          factorization_ = kCholeskyFactorization;
+        else
+          factorization_ = kLuFactorization;
+      }
+      if (factorization_ != kQrFactorization && a.rows() != a.cols()) {
+        std::cerr << "MATRIX IS NOT A SQUARE MATRIX!";
+        exit(1);
+      }
+      if (factorization_ == kCholeskyFactorization) {
+        llt_.compute(a);
+        // Symmetric indefinite matrices go to LU
+        if (llt_.info() != Eigen::Success) {
+          factorization_ = kLuFactorization;
+        } else {
+          pivots_ = llt_.matrixLLT().diagonal().cwiseAbs2();
+          // l_ii^2 is a_ii minus the part explained by the earlier rows
+          scales_ = a.diagonal().cwiseAbs();
+          return;
+        }
+      }
+      if (factorization_ == kLuFactorization) {
+        lu_.compute(a);
+        pivots_ = lu_.matrixLU().diagonal().cwiseAbs();
+        // The pivot of row i of P A against the largest entry of that row
+        scales_ = lu_.permutationP() *
+            a.cwiseAbs().rowwise().maxCoeff();
+      } else {
+        qr_.compute(a);
+        pivots_ = qr_.matrixQR().diagonal().cwiseAbs();
+        // The pivot of column i of A P against the largest entry of that
+        // column
+        Vector<T> largest = a.cwiseAbs().colwise().maxCoeff().transpose();
+        scales_.resize(pivots_.size());
+        for (int i = 0; i < pivots_.size(); i++)
+          scales_(i) = largest(qr_.colsPermutation().indices()(i));
+      }
+    }
+
+    /// Solves A X = B, or min |A X - B| for a rectangular A
+    Matrix<T> Solve(const Matrix<T> &b) const {
+      Matrix<T> x;
+      Solve(b, &x);
+      return x;
+    }
+
+    /// Writes the solution of A X = B into x, which may not alias b
+    template<typename B, typename Out>
+    void Solve(const Eigen::MatrixBase<B> &b,
+               Eigen::MatrixBase<Out> *x) const {
+      if (b.rows() != rows_) {
+        std::cerr << "MATRICES ARE NOT THE SAME SIZE!";
+        exit(1);
+      }
+      if (factorization_ == kCholeskyFactorization)
+        x->derived() = llt_.solve(b);
+      else if (factorization_ == kLuFactorization)
+        x->derived() = lu_.solve(b);
+      else
+        x->derived() = qr_.solve(b);
+    }
+
+    /// The factorization in use
+    Factorization GetFactorization() const {
+      return factorization_;
+    }
+
+    /// The log of |det(A)| of a square A, which does not overflow like the
+    /// determinant
+    T LogDeterminant() const {
+      if (rows_ != cols_) {
+        std::cerr << "MATRIX IS NOT SQUARE AND CANNOT CALCULATE DETERMINANT";
+        exit(1);
+      }
+      return pivots_.array().log().sum();
+    }
+
+    /// An estimate of the reciprocal condition number of A in the 1-norm,
+    /// between 0 for a singular and 1 for a perfectly conditioned matrix
+    T ConditionEstimate() const {
+      if (!IsInvertible())
+        return 0;
+#if EIGEN_VERSION_AT_LEAST(3, 3, 0)
+      if (factorization_ == kCholeskyFactorization)
+        return llt_.rcond();
+      else if (factorization_ == kLuFactorization)
+        return lu_.rcond();
+#endif
+      return pivots_.minCoeff() / pivots_.maxCoeff();
+    }
+
+    /// Whether A has full rank, that is every pivot of the factorization
+    /// is above eps * min(rows, cols) times the scale of its row (LU), its
+    /// column (QR) or its diagonal entry (Cholesky). Rounding leaves the
+    /// pivots of a numerically singular A at about eps times that scale,
+    /// while a badly scaled but regular A, such as diag(1e-20, 1e20),
+    /// still counts as invertible, see ConditionEstimate.
+    bool IsInvertible() const {
+      T tolerance =
+          std::numeric_limits<T>::epsilon() * std::min(rows_, cols_);
+      for (int i = 0; i < pivots_.size(); i++)
+        if (!(pivots_(i) > tolerance * scales_(i)))
+          return false;
+      return true;
+    }
+
+   private:
+    int rows_;
+    int cols_;
+    Factorization factorization_;
+    Eigen::LLT<Matrix<T>> llt_;
+    Eigen::PartialPivLU<Matrix<T>> lu_;
+    Eigen::ColPivHouseholderQR<Matrix<T>> qr_;
+    // The magnitudes of the pivots, whose product is |det(A)|
+    Vector<T> pivots_;
+    // The scale of A each pivot is compared to by IsInvertible
+    Vector<T> scales_;
+  };
+
   /// This is a function that returns the inverse of a matrix.
   ///
   /// \param a
@@ -271,7 +570,19 @@ class CpuOperations {
   ///
   /// \return
   /// This function returns a matrix that is the inverse of the input matrix.
+  ///
+  /// \sa
+  /// \ref Solver, which solves linear systems without the inverse
   static Matrix<T> Inverse(const Matrix<T> &a) {
+    Matrix<T> result;
+    Inverse(a, &result);
+    return result;
+  }
+
+  /// Writes the inverse of a into result, which must not alias a
+  template<typename A, typename Out>
+  static void Inverse(const Eigen::MatrixBase<A> &a,
+                      Eigen::MatrixBase<Out> *result) {
     // If the matrix is empty, it should not check for inverse.
     if (a.cols() == 0) {
       std::cerr << "MATRIX IS EMPTY";
@@ -280,16 +591,14 @@ class CpuOperations {
     } else if (a.cols() != a.rows()) {
       std::cerr << "MATRIX IS NOT A SQUARE MATRIX!";
       exit(1);
-
-      // If the determinant of a matrix is 0, it does not have an inverse.
-    } else if (a.determinant() == 0) {
-      std::cerr << "MATRIX DOES NOT HAVE AN INVERSE (DETERMINANT IS ZERO)!";
+    }
+    // A single factorization both finds singular matrices and inverts
+    Solver solver(a, kLuFactorization);
+    if (!solver.IsInvertible()) {
+      std::cerr << "MATRIX DOES NOT HAVE AN INVERSE (IT IS SINGULAR)!";
       exit(1);
-
-      // If this point is reached then an inverse of the matrix exists.
-    } else {
-      return a.inverse();
     }
+    solver.Solve(Matrix<T>::Identity(a.rows(), a.cols()), result);
   }
 
   /// static Vector <T> Norm( const Matrix <T> &a,
@@ -299,7 +608,9 @@ class CpuOperations {
   /// the norm will be calulated column wise and the size of the
   /// output vector will be dependent on n. If the axis is 1, the
   /// norm will be calculated row-wise and the size of the vector
-  /// will be dependent on m.
+  /// will be dependent on m. p = 1, 2 and kInfinityNorm use vectorized
+  /// kernels, other p > 0 fall back to a generic one, and the row norms
+  /// are accumulated column by column in memory order.
   ///
   /// \param a
   /// const Matrix <T> &a
@@ -312,27 +623,49 @@ class CpuOperations {
   /// Vector <T>
   static Vector<T> Norm(const Matrix<T> &a, const int &p = 2, const int &axis =
                             0) {
-    int num_rows = a.rows();
-    int num_cols = a.cols();
-    float norm_value = 0;
+    Vector<T> norm;
+    Norm(a, p, axis, &norm);
+    return norm;
+  }
+
+  /// Writes the p-norms of the columns (axis 0) or rows (axis 1) of a into
+  /// the vector result
+  template<typename A, typename Out>
+  static void Norm(const Eigen::MatrixBase<A> &a, const int &p,
+                   const int &axis, Eigen::MatrixBase<Out> *result) {
+    if (p <= 0 && p != kInfinityNorm) {
+      std::cerr << "P must be positive or kInfinityNorm!";
+      exit(1);
+    }
+    Out &norm = result->derived();
     if (axis == 0) {
-      Vector<T> norm(num_cols);
-      for (int j = 0; j < num_cols; j++) {
-        for (int i = 0; i < num_rows; i++)
-          norm_value += pow(a(i, j), p);
-        norm(j) = pow(norm_value, (1.0 / p));
-        norm_value = 0;
-      }
-      return norm;
+      if (p == 1)
+        norm = a.cwiseAbs().colwise().sum().transpose();
+      else if (p == 2)
+        norm = a.colwise().norm().transpose();
+      else if (p == kInfinityNorm)
+        norm = a.cwiseAbs().colwise().maxCoeff().transpose();
+      else
+        norm = a.array().abs().pow(T(p)).colwise().sum().pow(T(1) / p)
+            .matrix().transpose();
     } else if (axis == 1) {
-      Vector<T> norm(num_rows);
-      for (int i = 0; i < num_rows; i++) {
-        for (int j = 0; j < num_cols; j++)
-          norm_value += pow(a(i, j), p);
-        norm(i) = pow(norm_value, (1.0 / p));
-        norm_value = 0;
+      // A column major matrix is read one column at a time
+      norm.resize(a.rows(), 1);
+      norm.setZero();
+      for (int j = 0; j < a.cols(); j++) {
+        if (p == 1)
+          norm += a.col(j).cwiseAbs();
+        else if (p == 2)
+          norm += a.col(j).cwiseAbs2();
+        else if (p == kInfinityNorm)
+          norm = norm.cwiseMax(a.col(j).cwiseAbs());
+        else
+          norm.array() += a.col(j).array().abs().pow(T(p));
       }
-      return norm;
+      if (p == 2)
+        norm = norm.cwiseSqrt();
+      else if (p != 1 && p != kInfinityNorm)
+        norm = norm.array().pow(T(1) / p).matrix();
     } else {
       std::cerr << "Axis must be zero or one!";
       exit(1);
@@ -440,12 +773,22 @@ class CpuOperations {
   /// \return
   /// This function returns a Matrix of type T
   static Matrix<T> OuterProduct(const Vector<T> &a, const Vector<T> &b) {
+    Matrix<T> result;
+    OuterProduct(a, b, &result);
+    return result;
+  }
+
+  /// Writes the outer product of the vectors a and b into result
+  template<typename A, typename B, typename Out>
+  static void OuterProduct(const Eigen::MatrixBase<A> &a,
+                           const Eigen::MatrixBase<B> &b,
+                           Eigen::MatrixBase<Out> *result) {
     // This function returns the outer product of he two passed in vectors
     if (a.size() == 0 || b.size() == 0) {
       std::cerr << "EMPTY VECTOR AS ARGUMENT!";
       exit(1);
     }
-    return a * b.transpose();
+    result->derived().noalias() = a * b.transpose();
   }
 
   /// This is a function that calculates the "logical and" of the two input
@@ -521,45 +864,109 @@ class CpuOperations {
   /// This function returns a value of type Matrix<T>
   ///
   static Matrix<T> Center(const Matrix<T> &a, const int axis = 0) {
-    // Include: axis, default subtract means from columns, if 1, remove means
-    // from rows
-    //
+    Matrix<T> b = a;
+    Center(&b, axis);
+    return b;
+  }
+
+  /// This function centers a matrix in place, subtracting the mean of every
+  /// column (axis 0) or row (axis 1) by broadcast in O(m * n) time without
+  /// forming a centering matrix
+  ///
+  /// \param a
+  /// The matrix to center
+  ///
+  /// \param axis
+  /// The axis that you are centering along, 0 for cols and 1 for rows
+  template<typename A>
+  static void Center(Eigen::MatrixBase<A> *a, const int axis = 0) {
     // If the matrix is empty, exit with error message
-    if (a.rows() == 0 || a.cols() == 0) {
+    if (a->rows() == 0 || a->cols() == 0) {
       std::cerr << "EMPTY MATRIX AS ARGUMENT!";
       exit(1);  // Exits the program
     }
-    // If the axis is not 0 (default) or 1, exit with error message
-    if (axis != 0 && axis != 1) {
+    if (axis == 0) {  // Remove means from columns
+      Vector<T> mean = a->colwise().mean().transpose();
+      a->rowwise() -= mean.transpose();
+    } else if (axis == 1) {  // Remove means from rows
+      Vector<T> mean = a->rowwise().mean();
+      a->colwise() -= mean;
+    } else {
       std::cerr << "BAD AXIS! AXIS MUST BE 0 OR 1!";
       exit(1);
     }
-    // Otherwise,  matrix is an m x n matrix
-    int m = a.rows();
-    int n = a.cols();
-    Matrix<T> one;  // Matrix of size (m x m) OR (n x n) filled with just ones
-    Matrix<T> identity_matrix;
-    Matrix<T> centering_matrix;
+  }
 
-    if (axis == 0) {  // Remove means from columns
-      // Calculate Cm
-      centering_matrix = identity_matrix.Identity(m, m)
-          - one.Constant(m, m, 1.0 / m);
-      return centering_matrix * a;
-    } else if (axis == 1) {  // Remove means from Rows
-      centering_matrix = identity_matrix.Identity(n, n)
-          - one.Constant(n, n, 1.0 / n);
-      return a * centering_matrix;
-    } else {
-      std::cerr << "BAD AXIS! AXIS MUST BE 0 or 1!";
+  /// Writes a centered along axis into result, which may be a itself
+  template<typename A, typename Out>
+  static void Center(const Eigen::MatrixBase<A> &a, const int axis,
+                     Eigen::MatrixBase<Out> *result) {
+    result->derived() = a;
+    Center(result, axis);
+  }
+
+  /// This function computes the mean and the population variance of every
+  /// column (axis 0) or row (axis 1) of a matrix in a single pass, merging
+  /// blocks of samples with the Welford/Chan update. Large matrices are
+  /// split across threads.
+  ///
+  /// \param a
+  /// Input matrix
+  /// \param mean
+  /// Output means
+  /// \param variance
+  /// Output variances
+  /// \param axis
+  /// 0 for the statistics of the columns and 1 for those of the rows
+  template<typename A>
+  static void MeanVariance(const Eigen::MatrixBase<A> &a, Vector<T> *mean,
+                           Vector<T> *variance, const int axis = 0) {
+    if (a.rows() == 0 || a.cols() == 0) {
+      std::cerr << "EMPTY MATRIX!";
       exit(1);
     }
+    if (axis != 0 && axis != 1) {
+      std::cerr << "Axis must be 0 or 1!";
+      exit(1);
+    }
+    // The samples run along the rows for axis 0, and the columns for axis 1
+    int num_samples = axis == 0 ? a.rows() : a.cols();
+    int num_threads = 1;
+    if (a.size() >= (1 << 20))
+      num_threads = std::min<int>(std::thread::hardware_concurrency(),
+                                  num_samples / 256);
+    num_threads = std::max(num_threads, 1);
+    std::vector<RunningMeanVariance<T>> partial(num_threads);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; t++) {
+      int begin = static_cast<int64_t>(num_samples) * t / num_threads;
+      int end = static_cast<int64_t>(num_samples) * (t + 1) / num_threads;
+      auto accumulate = [&a, &partial, axis, t, begin, end]() {
+        for (int i = begin; i < end; i += 256) {
+          int size = std::min(256, end - i);
+          if (axis == 0)
+            partial[t].Add(a.middleRows(i, size));
+          else
+            partial[t].Add(a.middleCols(i, size).transpose());
+        }
+      };
+      if (num_threads == 1)
+        accumulate();
+      else
+        threads.push_back(std::thread(accumulate));
+    }
+    for (auto &thread : threads)
+      thread.join();
+    for (int t = 1; t < num_threads; t++)
+      partial[0].Merge(partial[t]);
+    *mean = partial[0].Mean();
+    *variance = partial[0].Variance();
   }
 /// statix Matrix <T> Normalize(const Matrix <T> &a, const int &p
 /// =2, const int &axis = 0) normalizes a m x n matrix by element.
 ///
 /// \param a
-/// const Matrix<T> &a
+/// const Matrix <T> &a
 /// \param b
 /// const int &p = 2
 /// \param c
@@ -571,19 +978,40 @@ class CpuOperations {
 /// \ref Norm
   static Matrix<T> Normalize(const Matrix<T> &a, const int &p = 2,
                              const int &axis = 0) {
-    int num_rows = a.rows();
-    int num_cols = a.cols();
-    Matrix<T> b(num_rows, num_cols);
-    if (axis == 0) {
-      b = a.transpose().array().colwise() / Norm(a, p, axis).array();
-      return b.transpose();
-    } else if (axis == 1) {
-      b = a.array().colwise() / Norm(a, p, axis).array();
-      return b;
-    } else {
-      std::cerr << "Axis must be zero or one!";
-      exit(1);
-    }
+    Matrix<T> b = a;
+    Normalize(&b, p, axis);
+    return b;
+  }
+
+  /// This function divides every column (axis 0) or row (axis 1) of a
+  /// matrix by its p-norm in place
+  ///
+  /// \param a
+  /// The matrix to normalize
+  /// \param p
+  /// The norm, as in Norm
+  /// \param axis
+  /// 0 to normalize the columns and 1 the rows
+  ///
+  /// \sa
+  /// \ref Norm
+  template<typename A>
+  static void Normalize(Eigen::MatrixBase<A> *a, const int &p = 2,
+                        const int &axis = 0) {
+    Vector<T> norm;
+    Norm(*a, p, axis, &norm);
+    if (axis == 0)
+      a->array().rowwise() /= norm.transpose().array();
+    else
+      a->array().colwise() /= norm.array();
+  }
+
+  /// Writes a normalized along axis into result, which may be a itself
+  template<typename A, typename Out>
+  static void Normalize(const Eigen::MatrixBase<A> &a, const int &p,
+                        const int &axis, Eigen::MatrixBase<Out> *result) {
+    result->derived() = a;
+    Normalize(result, p, axis);
   }
   /// Generates a kernel matrix from an input data_matrix
   /// \param data_matrix
@@ -600,9 +1028,21 @@ class CpuOperations {
                                    const KernelType kernel_type =
                                        kGaussianKernel,
                                    const float constant = 1.0) {
-    int num_samples = data_matrix.rows();
     // An n x n kernel matrix
-    Matrix<T> kernel_matrix(num_samples, num_samples);
+    Matrix<T> kernel_matrix;
+    GenKernelMatrix(data_matrix, kernel_type, constant, &kernel_matrix);
+    return kernel_matrix;
+  }
+
+  /// Writes the n x n kernel matrix of data_matrix into result
+  template<typename A, typename Out>
+  static void GenKernelMatrix(const Eigen::MatrixBase<A> &data_matrix,
+                              const KernelType kernel_type,
+                              const float constant,
+                              Eigen::MatrixBase<Out> *result) {
+    int num_samples = data_matrix.rows();
+    Out &kernel_matrix = result->derived();
+    kernel_matrix.resize(num_samples, num_samples);
     if (kernel_type == kGaussianKernel) {
       float sigma_sq = constant * constant;
       // This for loop generates the kernel matrix using Gaussian kernel
@@ -614,7 +1054,6 @@ class CpuOperations {
           kernel_matrix(i, j) = exp(-i_j_dist / (2 * sigma_sq));
         }
     }
-    return kernel_matrix;
   }
 
   /// Generates a degree matrix D from an input kernel matrix
@@ -635,6 +1074,103 @@ class CpuOperations {
     *degree_matrix_to_the_minus_half = d_i.array().sqrt().unaryExpr(
         std::ptr_fun(util::reciprocal<T>)).matrix().asDiagonal();
   }
+
+  /// Computes a low rank factor G of a positive semidefinite kernel matrix K
+  /// with K ~ G * G^T by the pivoted incomplete Cholesky decomposition. Each
+  /// step picks the largest remaining diagonal entry as the pivot and only
+  /// evaluates the kernel column of that pivot, so building an n x r factor
+  /// costs O(n * r^2) and r kernel columns, and K is never formed.
+  ///
+  /// \param kernel
+  /// A function with kernel(i, j) = K(i, j)
+  /// \param n
+  /// The size of K
+  /// \param tolerance
+  /// The decomposition stops once the trace of K - G * G^T is below
+  /// tolerance times the trace of K
+  /// \param max_rank
+  /// The largest number of columns of G, or 0 for no limit
+  /// \param pivots
+  /// If not null, receives the pivot of every column of G
+  ///
+  /// \return
+  /// An n x r factor G, where r is the rank reached
+  template<typename KernelFunction>
+  static Matrix<T> IncompleteCholeskyFromKernel(
+      const KernelFunction &kernel, const int n, const T tolerance = 1e-6,
+      const int max_rank = 0, std::vector<int> *pivots = nullptr) {
+    if (n == 0) {
+      std::cerr << "EMPTY MATRIX AS ARGUMENT!";
+      exit(1);
+    }
+    int rank_limit = max_rank > 0 ? std::min(max_rank, n) : n;
+    // The diagonal of the residual K - G * G^T
+    Vector<T> residual(n);
+    for (int i = 0; i < n; i++)
+      residual(i) = kernel(i, i);
+    T stop = tolerance * residual.sum();
+    Matrix<T> g(n, std::min(rank_limit, 16));
+    if (pivots != nullptr)
+      pivots->clear();
+    int rank = 0;
+    while (rank < rank_limit) {
+      int pivot;
+      T largest = residual.maxCoeff(&pivot);
+      if (residual.sum() <= stop || largest <= 0)
+        break;
+      if (rank == g.cols())
+        g.conservativeResize(n, std::min(2 * rank, rank_limit));
+      Vector<T> column(n);
+      for (int i = 0; i < n; i++)
+        column(i) = kernel(i, pivot);
+      column.noalias() -= g.leftCols(rank) *
+          g.row(pivot).head(rank).transpose();
+      g.col(rank) = column / std::sqrt(largest);
+      residual -= g.col(rank).cwiseAbs2();
+      // Rounding must not bring back a used pivot
+      residual(pivot) = 0;
+      residual = residual.cwiseMax(T(0));
+      if (pivots != nullptr)
+        pivots->push_back(pivot);
+      rank++;
+    }
+    return g.leftCols(rank);
+  }
+
+  /// Computes a low rank factor G of the kernel matrix of data_matrix with
+  /// the pivoted incomplete Cholesky decomposition, evaluating the kernel
+  /// like GenKernelMatrix but only for the pivot columns
+  ///
+  /// \param data_matrix
+  /// Input matrix whose rows represent samples and columns represent features
+  /// \param kernel_type
+  /// Kernel type, only the Gaussian kernel is supported
+  /// \param constant
+  /// In Gaussian kernel, this is sigma
+  /// \param tolerance
+  /// The relative trace tolerance of K - G * G^T
+  /// \param max_rank
+  /// The largest number of columns of G, or 0 for no limit
+  ///
+  /// \return
+  /// An n x r factor G with K ~ G * G^T
+  static Matrix<T> IncompleteCholesky(const Matrix<T> &data_matrix,
+                                      const KernelType kernel_type =
+                                          kGaussianKernel,
+                                      const float constant = 1.0,
+                                      const T tolerance = 1e-6,
+                                      const int max_rank = 0) {
+    if (kernel_type != kGaussianKernel) {
+      std::cerr << "INCOMPLETE CHOLESKY ONLY SUPPORTS THE GAUSSIAN KERNEL!";
+      exit(1);
+    }
+    float sigma_sq = constant * constant;
+    return IncompleteCholeskyFromKernel(
+        [&data_matrix, sigma_sq](int i, int j) -> T {
+          T i_j_dist = (data_matrix.row(i) - data_matrix.row(j)).norm();
+          return std::exp(-i_j_dist / (2 * sigma_sq));
+        }, data_matrix.rows(), tolerance, max_rank);
+  }
   /// Calculates the standard deviation of a given matrix and returns it as a
   /// vector.
   ///
@@ -653,36 +1189,107 @@ class CpuOperations {
     // Std = sqrt(1/n*[(x1-u)^2+(x2-u)^2...+(xn-u)^2])
     // u = average of the vector
     // n = number of the elements
-    if (a.rows() == 0 || a.cols() == 0) {
-      std::cerr << "EMPTY MATRIX!";
-      exit(1);
+    Vector<T> result;
+    StandardDeviation(a, axis, &result);
+    return result;
+  }
+
+  /// Writes the standard deviations of the columns (axis 0) or rows (axis 1)
+  /// of a into the vector result
+  template<typename A, typename Out>
+  static void StandardDeviation(const Eigen::MatrixBase<A> &a,
+                                const int axis,
+                                Eigen::MatrixBase<Out> *result) {
+    Vector<T> mean, variance;
+    MeanVariance(a, &mean, &variance, axis);
+    result->derived() = variance.cwiseSqrt();
+  }
+
+  /// The lazy variants of the arithmetic operations. Each one checks the
+  /// sizes like its eager counterpart but returns an Eigen expression
+  /// instead of a Matrix, so a chain such as
+  ///
+  ///     Matrix<T> c = Lazy::Multiply(Lazy::Subtract(a, b), s);
+  ///
+  /// is evaluated in a single pass when it is assigned, with no temporary
+  /// per step. The expressions refer to their operands, which must outlive
+  /// them, so they are meant to be assigned right away rather than kept.
+  class Lazy {
+   public:
+    template<typename A>
+    static auto Transpose(const Eigen::MatrixBase<A> &a)
+        -> decltype(a.derived().transpose()) {
+      return a.derived().transpose();
     }
-    int num_rows = a.rows();
-    int num_cols = a.cols();
-
-    // Matrix<T> temp = a.array().colwise() - a.array().rowwise().mean();
-    // This is the same as centering the matrix row wise so we choose to
-    // center instead.
-    Matrix<T> b = Center(a, axis);
-    Vector<T> calculated_std;
-
-    if (axis == 0) {  // Find Standard Deviation of each column
-      b = b.array().pow(2);
-      calculated_std = b.array().colwise().sum();
-      calculated_std *= (1.0 / num_rows);
-      calculated_std = calculated_std.array().sqrt();
-      return calculated_std;
-    } else if (axis == 1) {  // Find Standard Deviation of each row
-      b = b.array().pow(2);  // Square every element
-      calculated_std = b.array().rowwise().sum();  // Sum entire row
-      calculated_std *= (1.0 / num_cols);  // multply by 1/size
-      calculated_std = calculated_std.array().sqrt();  // take square root
-      return calculated_std;
-    } else {  // Bad Axis
-      std::cerr << "Axis must be 0 or 1!";
-      exit(1);
+
+    template<typename A>
+    static auto Multiply(const Eigen::MatrixBase<A> &a, const T &scalar)
+        -> decltype(a.derived() * scalar) {
+      return a.derived() * scalar;
     }
-  }
+
+    /// The matrix product, which Eigen still evaluates into a temporary
+    /// when it is nested in a larger expression
+    template<typename A, typename B>
+    static auto Multiply(const Eigen::MatrixBase<A> &a,
+                         const Eigen::MatrixBase<B> &b)
+        -> decltype(a.derived() * b.derived()) {
+      if (a.cols() != b.rows()) {
+        std::cerr << "MATRICES ARE NOT THE SAME SIZE!";
+        exit(1);
+      }
+      return a.derived() * b.derived();
+    }
+
+    template<typename A>
+    static auto Add(const Eigen::MatrixBase<A> &a, const T &scalar)
+        -> decltype((a.derived().array() + scalar).matrix()) {
+      CheckNotEmpty(a);
+      return (a.derived().array() + scalar).matrix();
+    }
+
+    template<typename A, typename B>
+    static auto Add(const Eigen::MatrixBase<A> &a,
+                    const Eigen::MatrixBase<B> &b)
+        -> decltype(a.derived() + b.derived()) {
+      CheckSameSize(a, b);
+      return a.derived() + b.derived();
+    }
+
+    template<typename A>
+    static auto Subtract(const Eigen::MatrixBase<A> &a, const T &scalar)
+        -> decltype((a.derived().array() - scalar).matrix()) {
+      CheckNotEmpty(a);
+      return (a.derived().array() - scalar).matrix();
+    }
+
+    template<typename A, typename B>
+    static auto Subtract(const Eigen::MatrixBase<A> &a,
+                         const Eigen::MatrixBase<B> &b)
+        -> decltype(a.derived() - b.derived()) {
+      CheckSameSize(a, b);
+      return a.derived() - b.derived();
+    }
+
+   private:
+    template<typename A>
+    static void CheckNotEmpty(const Eigen::MatrixBase<A> &a) {
+      if (a.rows() == 0 || a.cols() == 0) {
+        std::cerr << "EMPTY MATRIX AS ARGUMENT!";
+        exit(1);
+      }
+    }
+
+    template<typename A, typename B>
+    static void CheckSameSize(const Eigen::MatrixBase<A> &a,
+                              const Eigen::MatrixBase<B> &b) {
+      if (a.rows() != b.rows() || a.cols() != b.cols()) {
+        std::cerr << "MATRICES ARE NOT THE SAME SIZE!";
+        exit(1);
+      }
+      CheckNotEmpty(a);
+    }
+  };
 };
 }  // namespace Nice
 #endif  // CPP_INCLUDE_CPU_OPERATIONS_H_
@@ -0,0 +1,132 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Northeastern University
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef CPP_INCLUDE_GRAPH_COARSENING_H_
+#define CPP_INCLUDE_GRAPH_COARSENING_H_
+
+#include <vector>
+#include <algorithm>
+#include <random>
+#include "Eigen/Sparse"
+
+namespace Nice {
+
+// Multilevel coarsening of a symmetric weighted graph by heavy-edge
+// matching (as in Metis and Graclus). Every level matches each node with
+// its unmatched neighbour of heaviest edge, visiting the nodes in random
+// order, and merges matched pairs into one coarse node. The coarse graph
+// is P^T W P for the n x n_c 0/1 prolongation P, so edge weights and
+// degrees are summed, and merged edges become self loops. Coarsening
+// stops at the target size or once a level shrinks the graph by less than
+// a tenth.
+template<typename T>
+class GraphCoarsening {
+ public:
+  GraphCoarsening() : seed_(0) {}
+
+  void SetSeed(unsigned int seed) {
+    seed_ = seed;
+  }
+
+  // Coarsens the affinity graph w until it has at most target_size nodes.
+  // Only the coarse levels are stored, level 0 being w itself.
+  void Coarsen(const Eigen::SparseMatrix<T> &w, int target_size) {
+    graphs_.clear();
+    prolongations_.clear();
+    std::mt19937 rng(seed_);
+    const Eigen::SparseMatrix<T> *graph = &w;
+    while (graph->rows() > target_size) {
+      Eigen::SparseMatrix<T> prolongation = Match(*graph, &rng);
+      if (prolongation.cols() > 0.9 * graph->rows())
+        break;
+      Eigen::SparseMatrix<T> coarse =
+          prolongation.transpose() * (*graph) * prolongation;
+      prolongations_.push_back(prolongation);
+      graphs_.push_back(coarse);
+      graph = &graphs_.back();
+    }
+  }
+
+  // The number of levels, including the original graph
+  int NumLevels() const {
+    return graphs_.size() + 1;
+  }
+
+  // The graph of level > 0
+  const Eigen::SparseMatrix<T> &Graph(int level) const {
+    return graphs_[level - 1];
+  }
+
+  // The 0/1 map from the nodes of level + 1 to the nodes of level
+  const Eigen::SparseMatrix<T> &Prolongation(int level) const {
+    return prolongations_[level];
+  }
+
+ private:
+  // Returns the prolongation of one level of heavy-edge matching
+  Eigen::SparseMatrix<T> Match(const Eigen::SparseMatrix<T> &graph,
+                               std::mt19937 *rng) const {
+    int n = graph.rows();
+    std::vector<int> order(n);
+    for (int i = 0; i < n; i++)
+      order[i] = i;
+    std::shuffle(order.begin(), order.end(), *rng);
+    std::vector<int> coarse(n, -1);
+    int num_coarse = 0;
+    for (int v = 0; v < n; v++) {
+      int i = order[v];
+      if (coarse[i] >= 0)
+        continue;
+      // The graph is symmetric, so column i holds the neighbours of i
+      int best = -1;
+      T heaviest = 0;
+      for (typename Eigen::SparseMatrix<T>::InnerIterator it(graph, i); it;
+           ++it) {
+        int j = it.row();
+        if (j != i && coarse[j] < 0 && it.value() > heaviest) {
+          heaviest = it.value();
+          best = j;
+        }
+      }
+      coarse[i] = num_coarse;
+      if (best >= 0)
+        coarse[best] = num_coarse;
+      num_coarse++;
+    }
+    std::vector<Eigen::Triplet<T>> triplets;
+    triplets.reserve(n);
+    for (int i = 0; i < n; i++)
+      triplets.push_back(Eigen::Triplet<T>(i, coarse[i], 1));
+    Eigen::SparseMatrix<T> prolongation(n, num_coarse);
+    prolongation.setFromTriplets(triplets.begin(), triplets.end());
+    return prolongation;
+  }
+
+  unsigned int seed_;
+  // graphs_[l] is level l + 1
+  std::vector<Eigen::SparseMatrix<T>> graphs_;
+  std::vector<Eigen::SparseMatrix<T>> prolongations_;
+};
+
+}  // namespace Nice
+
+#endif  // CPP_INCLUDE_GRAPH_COARSENING_H_
@@ -0,0 +1,433 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Northeastern University
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef CPP_INCLUDE_HNSW_INDEX_H_
+#define CPP_INCLUDE_HNSW_INDEX_H_
+
+#include <cmath>
+#include <vector>
+#include <queue>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <utility>
+#include <algorithm>
+#include <limits>
+#include <functional>
+#include <unordered_set>
+#include <random>
+#include <stdexcept>
+#include <mutex>  // NOLINT(build/c++11)
+#include <thread>  // NOLINT(build/c++11)
+#include "include/matrix.h"
+#include "include/vector.h"
+
+namespace Nice {
+
+// Approximate nearest neighbour index over the columns of a d x n matrix
+// (Malkov and Yashunin, Hierarchical Navigable Small World graphs).
+// Every point gets a random level, and on each level up to its own it is
+// linked to at most m close points (2 m on level 0). Queries descend
+// greedily from the top level and search level 0 with a candidate list of
+// size ef. Larger m, ef_construction and ef trade speed for recall, which
+// Recall measures against brute force.
+template<typename T>
+class HnswIndex {
+ public:
+  // The squared distance and the column index of a point
+  typedef std::pair<T, int> Neighbor;
+
+  HnswIndex()
+      : m_(16), ef_construction_(200), ef_(50), seed_(100),
+        num_threads_(std::max(std::thread::hardware_concurrency(), 1u)),
+        entry_(-1), max_level_(-1) {}
+
+  HnswIndex(int m, int ef_construction)
+      : m_(m), ef_construction_(ef_construction), ef_(50), seed_(100),
+        num_threads_(std::max(std::thread::hardware_concurrency(), 1u)),
+        entry_(-1), max_level_(-1) {}
+
+  // The size of the candidate list of queries
+  void SetEf(int ef) {
+    ef_ = ef;
+  }
+
+  void SetNumThreads(unsigned int n) {
+    num_threads_ = std::max(n, 1u);
+  }
+
+  // The seed of the random point levels
+  void SetSeed(unsigned int seed) {
+    seed_ = seed;
+  }
+
+  // Indexes the columns of points, inserting them on num_threads_ threads
+  void Build(const Matrix<T> &points) {
+    int n = points.cols();
+    points_ = points;
+    entry_ = -1;
+    max_level_ = -1;
+    levels_.resize(n);
+    links_.assign(n, std::vector<std::vector<int>>());
+    std::mt19937 rng(seed_);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    double level_mult = 1 / std::log(std::max(m_, 2));
+    for (int i = 0; i < n; i++) {
+      levels_[i] = static_cast<int>(
+          -std::log(1.0 - uniform(rng)) * level_mult);
+      links_[i].resize(levels_[i] + 1);
+    }
+    if (n == 0)
+      return;
+    std::vector<std::mutex> locks(n);
+    std::mutex entry_lock;
+    Insert(0, &locks, &entry_lock);
+    unsigned int num_threads =
+        std::min<unsigned int>(num_threads_, std::max(n - 1, 1));
+    std::vector<std::thread> threads;
+    for (unsigned int t = 1; t < num_threads; t++)
+      threads.push_back(std::thread(&HnswIndex::InsertRange, this,
+                                    1 + t, num_threads, &locks,
+                                    &entry_lock));
+    InsertRange(1, num_threads, &locks, &entry_lock);
+    for (unsigned int t = 0; t < threads.size(); t++)
+      threads[t].join();
+  }
+
+  // The k approximate nearest points of query, closest first
+  std::vector<Neighbor> Search(const T *query, int k) const {
+    std::vector<Neighbor> result;
+    if (entry_ < 0)
+      return result;
+    Neighbor entry = GreedyDescend(query, entry_, max_level_, 0, NULL);
+    result = SearchLevel(query, entry, std::max(ef_, k), 0, NULL);
+    if (static_cast<int>(result.size()) > k)
+      result.resize(k);
+    return result;
+  }
+
+  // Returns the column index of the approximate nearest point of query,
+  // and its squared distance in min_dist, like KdTree::FindNearest
+  int FindNearest(const T *query, T *min_dist) const {
+    std::vector<Neighbor> result = Search(query, 1);
+    if (result.empty()) {
+      *min_dist = std::numeric_limits<T>::max();
+      return -1;
+    }
+    *min_dist = result[0].first;
+    return result[0].second;
+  }
+
+  int FindNearest(const Vector<T> &query, T *min_dist) const {
+    return FindNearest(query.data(), min_dist);
+  }
+
+  // The fraction of the true k nearest points, by brute force, found by
+  // Search for the columns of queries
+  T Recall(const Matrix<T> &queries, int k) const {
+    int n = points_.cols();
+    k = std::min(k, n);
+    if (k == 0 || queries.cols() == 0)
+      return 1;
+    int found = 0;
+    std::vector<Neighbor> exact(n);
+    for (int q = 0; q < queries.cols(); q++) {
+      for (int i = 0; i < n; i++)
+        exact[i] = Neighbor(
+            (points_.col(i) - queries.col(q)).squaredNorm(), i);
+      std::partial_sort(exact.begin(), exact.begin() + k, exact.end());
+      std::unordered_set<int> truth;
+      for (int i = 0; i < k; i++)
+        truth.insert(exact[i].second);
+      Vector<T> query = queries.col(q);
+      std::vector<Neighbor> result = Search(query.data(), k);
+      for (unsigned int i = 0; i < result.size(); i++)
+        found += truth.count(result[i].second);
+    }
+    return static_cast<T>(found) / (queries.cols() * k);
+  }
+
+  // Writes the index, points included, to a binary file
+  void Save(const std::string &file_name) const {
+    std::ofstream out(file_name.c_str(), std::ios::binary);
+    if (!out)
+      throw std::runtime_error("Cannot open file " + file_name);
+    out.write(kMagic, sizeof(kMagic));
+    int header[8] = {static_cast<int>(sizeof(T)),
+                     static_cast<int>(points_.rows()),
+                     static_cast<int>(points_.cols()),
+                     m_, ef_construction_, ef_, entry_, max_level_};
+    out.write(reinterpret_cast<const char *>(header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(points_.data()),
+              sizeof(T) * points_.size());
+    for (unsigned int i = 0; i < links_.size(); i++) {
+      out.write(reinterpret_cast<const char *>(&levels_[i]), sizeof(int));
+      for (unsigned int l = 0; l < links_[i].size(); l++) {
+        int size = links_[i][l].size();
+        out.write(reinterpret_cast<const char *>(&size), sizeof(int));
+        out.write(reinterpret_cast<const char *>(links_[i][l].data()),
+                  sizeof(int) * size);
+      }
+    }
+    if (!out)
+      throw std::runtime_error("Cannot write file " + file_name);
+  }
+
+  // Reads an index written by Save
+  void Load(const std::string &file_name) {
+    std::ifstream in(file_name.c_str(), std::ios::binary);
+    if (!in)
+      throw std::runtime_error("Cannot open file " + file_name);
+    char magic[sizeof(kMagic)];
+    int header[8];
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char *>(header), sizeof(header));
+    if (!in || !std::equal(magic, magic + sizeof(magic), kMagic))
+      throw std::runtime_error(file_name + " is not an HNSW index");
+    if (header[0] != static_cast<int>(sizeof(T)))
+      throw std::runtime_error(file_name + " has another scalar type");
+    points_.resize(header[1], header[2]);
+    m_ = header[3];
+    ef_construction_ = header[4];
+    ef_ = header[5];
+    entry_ = header[6];
+    max_level_ = header[7];
+    if (entry_ >= header[2] || (entry_ < 0 && header[2] > 0))
+      throw std::runtime_error(file_name + " is corrupted");
+    in.read(reinterpret_cast<char *>(points_.data()),
+            sizeof(T) * points_.size());
+    levels_.resize(header[2]);
+    links_.assign(header[2], std::vector<std::vector<int>>());
+    for (int i = 0; i < header[2] && in; i++) {
+      in.read(reinterpret_cast<char *>(&levels_[i]), sizeof(int));
+      if (in && (levels_[i] < 0 || levels_[i] > max_level_))
+        throw std::runtime_error(file_name + " is corrupted");
+      links_[i].resize(levels_[i] + 1);
+      for (int l = 0; l <= levels_[i] && in; l++) {
+        int size = 0;
+        in.read(reinterpret_cast<char *>(&size), sizeof(int));
+        if (size < 0 || size > 2 * m_ + 1)
+          throw std::runtime_error(file_name + " is corrupted");
+        links_[i][l].resize(size);
+        in.read(reinterpret_cast<char *>(links_[i][l].data()),
+                sizeof(int) * size);
+        for (int j = 0; j < size; j++)
+          if (links_[i][l][j] < 0 || links_[i][l][j] >= header[2])
+            throw std::runtime_error(file_name + " is corrupted");
+      }
+    }
+    if (!in)
+      throw std::runtime_error(file_name + " is truncated");
+  }
+
+  int NumPoints() const {
+    return points_.cols();
+  }
+
+  int Dimension() const {
+    return points_.rows();
+  }
+
+  const Matrix<T> &Points() const {
+    return points_;
+  }
+
+  // The neighbours of point on level
+  const std::vector<int> &Links(int point, int level) const {
+    return links_[point][level];
+  }
+
+ private:
+  static const char kMagic[8];
+
+  T Distance(const T *query, int point) const {
+    return (points_.col(point) -
+            Eigen::Map<const Vector<T>>(query, points_.rows())).squaredNorm();
+  }
+
+  T Distance(int a, int b) const {
+    return (points_.col(a) - points_.col(b)).squaredNorm();
+  }
+
+  // Copies the neighbours of point on level, under its lock while building
+  void GetLinks(int point, int level, std::vector<std::mutex> *locks,
+                std::vector<int> *links) const {
+    if (locks != NULL) {
+      std::lock_guard<std::mutex> guard((*locks)[point]);
+      *links = links_[point][level];
+    } else {
+      *links = links_[point][level];
+    }
+  }
+
+  // Moves greedily from entry, a point of level top, to the closest point
+  // on every level above level, and returns it
+  Neighbor GreedyDescend(const T *query, int entry, int top, int level,
+                         std::vector<std::mutex> *locks) const {
+    Neighbor current(Distance(query, entry), entry);
+    std::vector<int> links;
+    for (int l = top; l > level; l--) {
+      bool changed = true;
+      while (changed) {
+        changed = false;
+        GetLinks(current.second, l, locks, &links);
+        for (unsigned int i = 0; i < links.size(); i++) {
+          T dist = Distance(query, links[i]);
+          if (dist < current.first) {
+            current = Neighbor(dist, links[i]);
+            changed = true;
+          }
+        }
+      }
+    }
+    return current;
+  }
+
+  // The ef closest points to query reachable on level from entry,
+  // closest first
+  std::vector<Neighbor> SearchLevel(const T *query, Neighbor entry, int ef,
+                                    int level,
+                                    std::vector<std::mutex> *locks) const {
+    std::unordered_set<int> visited;
+    visited.insert(entry.second);
+    std::priority_queue<Neighbor, std::vector<Neighbor>,
+                        std::greater<Neighbor>> candidates;
+    std::priority_queue<Neighbor> nearest;
+    candidates.push(entry);
+    nearest.push(entry);
+    std::vector<int> links;
+    while (!candidates.empty()) {
+      Neighbor current = candidates.top();
+      if (current.first > nearest.top().first)
+        break;
+      candidates.pop();
+      GetLinks(current.second, level, locks, &links);
+      for (unsigned int i = 0; i < links.size(); i++) {
+        if (!visited.insert(links[i]).second)
+          continue;
+        T dist = Distance(query, links[i]);
+        if (static_cast<int>(nearest.size()) < ef ||
+            dist < nearest.top().first) {
+          candidates.push(Neighbor(dist, links[i]));
+          nearest.push(Neighbor(dist, links[i]));
+          if (static_cast<int>(nearest.size()) > ef)
+            nearest.pop();
+        }
+      }
+    }
+    std::vector<Neighbor> result(nearest.size());
+    for (int i = result.size() - 1; i >= 0; i--) {
+      result[i] = nearest.top();
+      nearest.pop();
+    }
+    return result;
+  }
+
+  // Keeps up to m of the sorted candidates, skipping those closer to an
+  // already kept point than to the query, so that links spread out
+  std::vector<int> SelectNeighbors(const std::vector<Neighbor> &candidates,
+                                   int m) const {
+    std::vector<int> selected;
+    for (unsigned int i = 0; i < candidates.size() &&
+         static_cast<int>(selected.size()) < m; i++) {
+      bool keep = true;
+      for (unsigned int j = 0; j < selected.size() && keep; j++)
+        keep = Distance(candidates[i].second, selected[j]) >=
+            candidates[i].first;
+      if (keep)
+        selected.push_back(candidates[i].second);
+    }
+    return selected;
+  }
+
+  void InsertRange(int first, int step, std::vector<std::mutex> *locks,
+                   std::mutex *entry_lock) {
+    for (int i = first; i < static_cast<int>(levels_.size()); i += step)
+      Insert(i, locks, entry_lock);
+  }
+
+  void Insert(int point, std::vector<std::mutex> *locks,
+              std::mutex *entry_lock) {
+    int level = levels_[point];
+    std::unique_lock<std::mutex> entry_guard(*entry_lock);
+    int entry_point = entry_;
+    int max_level = max_level_;
+    if (entry_ < 0) {
+      entry_ = point;
+      max_level_ = level;
+      return;
+    }
+    // Only an insertion that raises the top level keeps the entry lock
+    if (level <= max_level)
+      entry_guard.unlock();
+    const T *query = points_.col(point).data();
+    Neighbor entry =
+        GreedyDescend(query, entry_point, max_level, level, locks);
+    for (int l = std::min(level, max_level); l >= 0; l--) {
+      std::vector<Neighbor> candidates =
+          SearchLevel(query, entry, ef_construction_, l, locks);
+      std::vector<int> neighbors = SelectNeighbors(candidates, m_);
+      {
+        std::lock_guard<std::mutex> guard((*locks)[point]);
+        links_[point][l] = neighbors;
+      }
+      int max_links = l == 0 ? 2 * m_ : m_;
+      for (unsigned int i = 0; i < neighbors.size(); i++) {
+        int other = neighbors[i];
+        std::lock_guard<std::mutex> guard((*locks)[other]);
+        std::vector<int> &links = links_[other][l];
+        links.push_back(point);
+        if (static_cast<int>(links.size()) > max_links) {
+          std::vector<Neighbor> pruned(links.size());
+          for (unsigned int j = 0; j < links.size(); j++)
+            pruned[j] = Neighbor(Distance(other, links[j]), links[j]);
+          std::sort(pruned.begin(), pruned.end());
+          links = SelectNeighbors(pruned, max_links);
+        }
+      }
+      entry = candidates[0];
+    }
+    if (level > max_level) {
+      entry_ = point;
+      max_level_ = level;
+    }
+  }
+
+  int m_;
+  int ef_construction_;
+  int ef_;
+  unsigned int seed_;
+  unsigned int num_threads_;
+  int entry_;
+  int max_level_;
+  Matrix<T> points_;
+  std::vector<int> levels_;
+  // links_[i][l] are the neighbours of point i on level l
+  std::vector<std::vector<std::vector<int>>> links_;
+};
+
+template<typename T>
+const char HnswIndex<T>::kMagic[8] = {'N', 'I', 'C', 'E', 'H', 'N', 'S', 'W'};
+
+}  // namespace Nice
+
+#endif  // CPP_INCLUDE_HNSW_INDEX_H_
@@ -0,0 +1,312 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Northeastern University
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef CPP_INCLUDE_KD_TREE_H_
+#define CPP_INCLUDE_KD_TREE_H_
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include "include/matrix.h"
+#include "include/vector.h"
+
+namespace Nice {
+
+// A static kd-tree over the columns of a d x n matrix. Every node keeps the
+// bounding box, the sum and the number of the points below it, which is
+// what the filtering k-means algorithm needs to assign whole cells at once.
+// The points are stored again in tree order so that the points of a node
+// are contiguous.
+template<typename T>
+class KdTree {
+ public:
+  struct Node {
+    // The points of the node are columns [begin, end) of Points()
+    int begin;
+    int end;
+    // Children indices, -1 for a leaf
+    int left;
+    int right;
+  };
+
+  // A neighbour as its squared distance and original column index
+  typedef std::pair<T, int> Neighbor;
+
+  KdTree() : leaf_size_(8) {}
+
+  explicit KdTree(int leaf_size) : leaf_size_(leaf_size) {}
+
+  void Build(const Matrix<T> &points) {
+    int dim = points.rows();
+    int n = points.cols();
+    index_.resize(n);
+    for (int i = 0; i < n; i++)
+      index_[i] = i;
+    nodes_.clear();
+    // Leaves hold at least leaf_size_ / 2 points, so this is usually
+    // enough; BuildNode grows the node matrices otherwise
+    int max_nodes = 4 * (n / std::max(leaf_size_, 1)) + 1;
+    lower_.resize(dim, max_nodes);
+    upper_.resize(dim, max_nodes);
+    sum_.resize(dim, max_nodes);
+    sum_squares_.resize(max_nodes);
+    if (n > 0)
+      BuildNode(points, 0, n);
+    lower_.conservativeResize(dim, nodes_.size());
+    upper_.conservativeResize(dim, nodes_.size());
+    sum_.conservativeResize(dim, nodes_.size());
+    sum_squares_.conservativeResize(nodes_.size());
+    points_.resize(dim, n);
+    for (int i = 0; i < n; i++)
+      points_.col(i) = points.col(index_[i]);
+  }
+
+  // Returns the original column index of the point closest to query,
+  // and its squared distance in min_dist
+  int FindNearest(const T *query, T *min_dist) const {
+    int nearest = -1;
+    *min_dist = std::numeric_limits<T>::max();
+    if (!nodes_.empty())
+      SearchNode(0, query, &nearest, min_dist);
+    return nearest;
+  }
+
+  int FindNearest(const Vector<T> &query, T *min_dist) const {
+    return FindNearest(query.data(), min_dist);
+  }
+
+  // Replaces neighbors with the k points closest to query, closest first
+  void FindKNearest(const T *query, int k,
+                    std::vector<Neighbor> *neighbors) const {
+    neighbors->clear();
+    if (!nodes_.empty() && k > 0)
+      SearchKNearest(0, query, k, neighbors);
+    std::sort_heap(neighbors->begin(), neighbors->end());
+  }
+
+  // Replaces neighbors with the points within squared distance radius_sq
+  // of query, in no particular order
+  void FindInRadius(const T *query, T radius_sq,
+                    std::vector<Neighbor> *neighbors) const {
+    neighbors->clear();
+    if (!nodes_.empty())
+      SearchRadius(0, query, radius_sq, neighbors);
+  }
+
+  int NumNodes() const {
+    return nodes_.size();
+  }
+
+  int NumPoints() const {
+    return points_.cols();
+  }
+
+  const Node &GetNode(int node) const {
+    return nodes_[node];
+  }
+
+  bool IsLeaf(int node) const {
+    return nodes_[node].left < 0;
+  }
+
+  int Count(int node) const {
+    return nodes_[node].end - nodes_[node].begin;
+  }
+
+  const Matrix<T> &Lower() const {
+    return lower_;
+  }
+
+  const Matrix<T> &Upper() const {
+    return upper_;
+  }
+
+  const Matrix<T> &Sum() const {
+    return sum_;
+  }
+
+  // The sum of the squared norms of the points of every node
+  const Vector<T> &SumSquares() const {
+    return sum_squares_;
+  }
+
+  // The points in tree order
+  const Matrix<T> &Points() const {
+    return points_;
+  }
+
+  // The original column index of the i-th point in tree order
+  int Index(int i) const {
+    return index_[i];
+  }
+
+ private:
+  int BuildNode(const Matrix<T> &points, int begin, int end) {
+    int id = nodes_.size();
+    if (id == lower_.cols()) {
+      lower_.conservativeResize(Eigen::NoChange, 2 * id);
+      upper_.conservativeResize(Eigen::NoChange, 2 * id);
+      sum_.conservativeResize(Eigen::NoChange, 2 * id);
+      sum_squares_.conservativeResize(2 * id);
+    }
+    Node node = {begin, end, -1, -1};
+    nodes_.push_back(node);
+    lower_.col(id) = points.col(index_[begin]);
+    upper_.col(id) = points.col(index_[begin]);
+    sum_.col(id).setZero();
+    sum_squares_(id) = 0;
+    for (int i = begin; i < end; i++) {
+      lower_.col(id) = lower_.col(id).cwiseMin(points.col(index_[i]));
+      upper_.col(id) = upper_.col(id).cwiseMax(points.col(index_[i]));
+      sum_.col(id) += points.col(index_[i]);
+      sum_squares_(id) += points.col(index_[i]).squaredNorm();
+    }
+    if (end - begin <= leaf_size_)
+      return id;
+    // Split at the median of the widest dimension of the bounding box
+    int split_dim;
+    T width = (upper_.col(id) - lower_.col(id)).maxCoeff(&split_dim);
+    if (width <= 0)
+      return id;
+    int mid = begin + (end - begin) / 2;
+    std::nth_element(index_.begin() + begin, index_.begin() + mid,
+                     index_.begin() + end,
+                     [&points, split_dim](int a, int b) {
+                       return points(split_dim, a) < points(split_dim, b);
+                     });
+    int left = BuildNode(points, begin, mid);
+    int right = BuildNode(points, mid, end);
+    nodes_[id].left = left;
+    nodes_[id].right = right;
+    return id;
+  }
+
+  // Squared distance from query to the bounding box of node
+  T BoxDistance(int node, const T *query) const {
+    T dist = 0;
+    for (int i = 0; i < lower_.rows(); i++) {
+      T diff = 0;
+      if (query[i] < lower_(i, node))
+        diff = lower_(i, node) - query[i];
+      else if (query[i] > upper_(i, node))
+        diff = query[i] - upper_(i, node);
+      dist += diff * diff;
+    }
+    return dist;
+  }
+
+  void SearchNode(int node, const T *query, int *nearest,
+                  T *min_dist) const {
+    const Node &n = nodes_[node];
+    int dim = points_.rows();
+    Eigen::Map<const Vector<T>> q(query, dim);
+    if (n.left < 0) {
+      for (int i = n.begin; i < n.end; i++) {
+        T dist = (points_.col(i) - q).squaredNorm();
+        if (dist < *min_dist) {
+          *min_dist = dist;
+          *nearest = index_[i];
+        }
+      }
+      return;
+    }
+    // Visit the closer child first so that the other one is more
+    // likely to be pruned
+    T left_dist = BoxDistance(n.left, query);
+    T right_dist = BoxDistance(n.right, query);
+    int first = n.left, second = n.right;
+    if (right_dist < left_dist) {
+      std::swap(first, second);
+      std::swap(left_dist, right_dist);
+    }
+    if (left_dist < *min_dist)
+      SearchNode(first, query, nearest, min_dist);
+    if (right_dist < *min_dist)
+      SearchNode(second, query, nearest, min_dist);
+  }
+
+  // neighbors is a max-heap of the k closest points found so far
+  void SearchKNearest(int node, const T *query, int k,
+                      std::vector<Neighbor> *neighbors) const {
+    const Node &n = nodes_[node];
+    if (n.left < 0) {
+      Eigen::Map<const Vector<T>> q(query, points_.rows());
+      for (int i = n.begin; i < n.end; i++) {
+        T dist = (points_.col(i) - q).squaredNorm();
+        if (static_cast<int>(neighbors->size()) < k) {
+          neighbors->push_back(Neighbor(dist, index_[i]));
+          std::push_heap(neighbors->begin(), neighbors->end());
+        } else if (dist < neighbors->front().first) {
+          std::pop_heap(neighbors->begin(), neighbors->end());
+          neighbors->back() = Neighbor(dist, index_[i]);
+          std::push_heap(neighbors->begin(), neighbors->end());
+        }
+      }
+      return;
+    }
+    T left_dist = BoxDistance(n.left, query);
+    T right_dist = BoxDistance(n.right, query);
+    int first = n.left, second = n.right;
+    if (right_dist < left_dist) {
+      std::swap(first, second);
+      std::swap(left_dist, right_dist);
+    }
+    if (static_cast<int>(neighbors->size()) < k ||
+        left_dist < neighbors->front().first)
+      SearchKNearest(first, query, k, neighbors);
+    if (static_cast<int>(neighbors->size()) < k ||
+        right_dist < neighbors->front().first)
+      SearchKNearest(second, query, k, neighbors);
+  }
+
+  void SearchRadius(int node, const T *query, T radius_sq,
+                    std::vector<Neighbor> *neighbors) const {
+    if (BoxDistance(node, query) > radius_sq)
+      return;
+    const Node &n = nodes_[node];
+    if (n.left < 0) {
+      Eigen::Map<const Vector<T>> q(query, points_.rows());
+      for (int i = n.begin; i < n.end; i++) {
+        T dist = (points_.col(i) - q).squaredNorm();
+        if (dist <= radius_sq)
+          neighbors->push_back(Neighbor(dist, index_[i]));
+      }
+      return;
+    }
+    SearchRadius(n.left, query, radius_sq, neighbors);
+    SearchRadius(n.right, query, radius_sq, neighbors);
+  }
+
+  int leaf_size_;
+  std::vector<Node> nodes_;
+  std::vector<int> index_;
+  Matrix<T> lower_;
+  Matrix<T> upper_;
+  Matrix<T> sum_;
+  Vector<T> sum_squares_;
+  Matrix<T> points_;
+};
+
+}  // namespace Nice
+
+#endif  // CPP_INCLUDE_KD_TREE_H_
@@ -24,32 +24,133 @@
 #define CPP_INCLUDE_KMEANS_H_
 
 #include <vector>
-#include <map>
 #include <algorithm>
 #include <limits>
+#include <numeric>
 #include <cstdlib>
+#include <exception>
+#include <queue>
+#include <random>
+#include <thread>  // NOLINT(build/c++11)
+#include <utility>
+#include <memory>
 #include "include/matrix.h"
 #include "include/vector.h"
+#include "include/kd_tree.h"
+#include "include/kmeans_predictor.h"
+#include "include/timer.h"
 
 
 namespace Nice {
 
+enum KMeansAlgorithm {
+  // Brute-force assignment of every point to every center
+  kLloydKMeans,
+  // Kanungo et al. filtering over a kd-tree of the points, much faster
+  // for low dimensional data with many clusters
+  kFilterKMeans,
+  // Recursive 2-means splits of one cluster at a time, for large k.
+  // Builds a center hierarchy that Predict descends in O(log k).
+  kBisectingKMeans
+};
+
+// The cluster a bisecting KMeans splits next
+enum KMeansBisectingStrategy {
+  kBisectLargestCluster,
+  kBisectHighestSSECluster
+};
+
+// A node of the bisecting KMeans center hierarchy. Its center is the
+// column with the same index in KMeans::GetHierarchyCenters().
+struct KMeansHierarchyNode {
+  // Children indices, -1 for a leaf
+  int left;
+  int right;
+  // The final cluster of a leaf, -1 for an inner node
+  int cluster;
+};
+
+// Per-iteration telemetry of the Lloyd iterations of KMeans, over all the
+// restarts of the last Fit or Run. Entry i of every vector, and of
+// timer.vec_ (in ms), describes the same iteration.
+template<typename T>
+struct KMeansIterationLog {
+  // The restart the iteration belongs to
+  std::vector<unsigned int> round;
+  // The mean squared distance of the points to their assigned centers
+  std::vector<T> inertia;
+  // The number of points whose label changed
+  std::vector<unsigned int> reassigned;
+  Timer timer;
+};
+
+// The scores of the fits of KMeans::SweepK, entry i is for k[i]
+template<typename T>
+struct KMeansSweepResult {
+  std::vector<unsigned int> k;
+  // The mean squared distance of the points to their centers
+  std::vector<T> inertia;
+  std::vector<T> silhouette;
+  // The k with the highest silhouette
+  unsigned int best_k;
+};
+
+// Points of dimension up to kKMeansMaxFixedDim are processed by kernels
+// instantiated with a compile-time dimension, so that the distance and
+// update loops are fully unrolled and the per-point temporaries live on
+// the stack instead of the heap. Larger dimensions use Eigen::Dynamic.
+const int kKMeansMaxFixedDim = 16;
+
+// Calls op.template Run<Dim>() with Dim equal to the runtime dimension dim,
+// or with Eigen::Dynamic when dim is larger than kKMeansMaxFixedDim
+template<int Dim = 1>
+struct KMeansDimDispatcher {
+  template<typename Op>
+  static void Dispatch(int dim, Op *op) {
+    if (dim == Dim)
+      op->template Run<Dim>();
+    else
+      KMeansDimDispatcher<Dim + 1>::Dispatch(dim, op);
+  }
+};
+
+template<>
+struct KMeansDimDispatcher<kKMeansMaxFixedDim + 1> {
+  template<typename Op>
+  static void Dispatch(int dim, Op *op) {
+    op->template Run<Eigen::Dynamic>();
+  }
+};
 
 template<typename T>
 class KMeans {
  public:
   void Fit(const Matrix<T> &input_data, int k) {
     k_ = k;
+    online_counts_.clear();
+    ClearHierarchy();
+    iteration_log_ = KMeansIterationLog<T>();
     centers_.resize(input_data.cols(), k_);
     T ref_sse = std::numeric_limits<T>::infinity();
-    Vector<T> running_labels = Vector<T>::Zero(input_data.cols());
-    Vector<T> running_centers = Vector<T>::Zero(k);
+    Vector<int> running_labels = Vector<int>::Zero(input_data.rows());
+    Matrix<T> running_centers = Matrix<T>::Zero(input_data.cols(), k);
     unsigned int t = time(NULL);
     srand48(t);
     srand(t);
+    Matrix<T> data = input_data.transpose();
+    // Bisecting runs its own restarts on every split
+    if (algorithm_ == kBisectingKMeans) {
+      RunBisecting(data);
+      Publish();
+      return;
+    }
+    // The tree only depends on the data, so it is shared by all restarts
+    if (algorithm_ == kFilterKMeans)
+      tree_.Build(data);
     for (unsigned int round = 0; round < n_init_; round++) {
-      Run(input_data.transpose());
-      T current_sse = GetSSE(input_data.transpose());
+      RunIterations(data, round);
+      // The SSE comes out of the last assignment pass
+      T current_sse = sse_;
       if (current_sse < ref_sse) {
         ref_sse = current_sse;
         running_labels = labels_;
@@ -58,9 +159,216 @@ class KMeans {
     }
     labels_ = running_labels;
     centers_ = running_centers;
+    sse_ = ref_sse;
+    Publish();
   }
 
   void Run(const Matrix<T> &input_data) {
+    online_counts_.clear();
+    ClearHierarchy();
+    iteration_log_ = KMeansIterationLog<T>();
+    if (algorithm_ == kBisectingKMeans) {
+      RunBisecting(input_data);
+    } else {
+      if (algorithm_ == kFilterKMeans)
+        tree_.Build(input_data);
+      RunIterations(input_data, 0);
+    }
+    Publish();
+  }
+
+  // Updates the centers with a batch of points (one per row) from a
+  // stream, in O(batch k d). Each point is assigned to its closest center
+  // and every center moves towards the mean of its batch points with
+  // rate batch count / (center count + batch count). The counts are
+  // multiplied by the SetDecay factor before every batch, so a decay
+  // below 1 lets the centers follow a drifting stream. With
+  // SetReseedFraction, centers whose count falls below that fraction of
+  // the mean count are moved to a batch point drawn by k-means++
+  // weighting. The first call on an unfitted model seeds k centers from
+  // the batch; later calls must pass the same k and points of the same
+  // dimension as the centers. The centers move away from the hierarchy
+  // of a bisecting fit, so it is dropped and Predict uses the closest
+  // center.
+  //
+  // PartialFit calls must not overlap, but Predict and GetPredictor may
+  // run concurrently with them: they use the centers published at the
+  // end of the last Fit, Run, SweepK or PartialFit.
+  void PartialFit(const Matrix<T> &batch, int k) {
+    Matrix<T> data = batch.transpose();
+    if (centers_.cols() == 0) {
+      k_ = k;
+      if (data.cols() < k_) {
+        std::stringstream ss;
+        ss << "The first batch (" << data.cols()
+           << " points) must be larger than the number of clusters ("
+           << k_ << ")";
+        throw std::runtime_error(ss.str());
+      }
+      KMeansPPInit(data);
+    }
+    if (k != static_cast<int>(k_)) {
+      std::stringstream ss;
+      ss << "The number of clusters (" << k
+         << ") must match the fitted one (" << k_ << ")";
+      throw std::runtime_error(ss.str());
+    }
+    if (data.rows() != centers_.rows()) {
+      std::stringstream ss;
+      ss << "The points have " << data.rows()
+         << " dimensions, the centers have " << centers_.rows();
+      throw std::runtime_error(ss.str());
+    }
+    ClearHierarchy();
+    if (online_counts_.empty()) {
+      // Continue from a batch fit with its cluster sizes as counts
+      online_counts_.assign(k_, 0);
+      for (unsigned int i = 0; i < labels_.size(); i++)
+        online_counts_[labels_(i)]++;
+    }
+    Vector<int> labels = Vector<int>::Constant(data.cols(), -1);
+    AssignLabelsOp op = {this, &data, k_, &labels, 0, 0};
+    KMeansDimDispatcher<>::Dispatch(data.rows(), &op);
+    Matrix<T> sums = Matrix<T>::Zero(data.rows(), k_);
+    std::vector<unsigned int> counts(k_, 0);
+    for (unsigned int i = 0; i < data.cols(); i++) {
+      sums.col(labels(i)) += data.col(i);
+      counts[labels(i)]++;
+    }
+    T total_count = 0;
+    for (unsigned int c = 0; c < k_; c++) {
+      online_counts_[c] *= decay_;
+      if (counts[c] > 0) {
+        T count = online_counts_[c] + counts[c];
+        centers_.col(c) += (sums.col(c) - counts[c] * centers_.col(c)) /
+            count;
+        online_counts_[c] = count;
+      }
+      total_count += online_counts_[c];
+    }
+    if (reseed_fraction_ > 0) {
+      Vector<T> weights(data.cols());
+      for (unsigned int i = 0; i < data.cols(); i++)
+        weights(i) = (centers_.col(labels(i)) - data.col(i)).squaredNorm();
+      T threshold = reseed_fraction_ * total_count / k_;
+      for (unsigned int c = 0; c < k_; c++) {
+        if (online_counts_[c] >= threshold || weights.sum() <= 0)
+          continue;
+        unsigned int point = SelectWeightedIndex(weights);
+        centers_.col(c) = data.col(point);
+        online_counts_[c] = 0;
+        weights(point) = 0;
+      }
+    }
+    Publish();
+  }
+
+  // Starts from a single cluster and splits the leaf chosen by
+  // bisecting_strategy_ with 2-means until there are k_ leaves.
+  // Up to num_threads_ leaves are split concurrently in every round.
+  void RunBisecting(const Matrix<T> &input_data) {
+    RunBisecting(input_data, rand());
+  }
+
+  // The same, with the seed of the 2-means splits given
+  void RunBisecting(const Matrix<T> &input_data, unsigned int seed) {
+    if (input_data.cols() < k_) {
+      std::stringstream ss;
+      ss << "The number of points (" << input_data.cols()
+         << ") must be larger than the number of clusters (" << k_ << ")";
+      throw std::runtime_error(ss.str());
+    }
+    int dim = input_data.rows();
+    hierarchy_.clear();
+    hierarchy_centers_.resize(dim, 2 * k_ - 1);
+    std::vector<std::vector<unsigned int>> members(2 * k_ - 1);
+    members[0].resize(input_data.cols());
+    for (unsigned int i = 0; i < input_data.cols(); i++)
+      members[0][i] = i;
+    KMeansHierarchyNode root = {-1, -1, -1};
+    hierarchy_.push_back(root);
+    hierarchy_centers_.col(0) = input_data.rowwise().mean();
+    T root_sse = (input_data.colwise() - hierarchy_centers_.col(0))
+        .colwise().squaredNorm().sum();
+    std::vector<T> sse(2 * k_ - 1);
+    sse[0] = root_sse;
+    // Leaves ordered by how much they need a split
+    std::priority_queue<std::pair<T, int>> leaves;
+    leaves.push(std::make_pair(BisectingScore(root_sse, members[0].size()),
+                               0));
+    unsigned int num_leaves = 1;
+    while (num_leaves < k_ && !leaves.empty()) {
+      std::vector<int> to_split;
+      while (!leaves.empty() && to_split.size() < num_threads_ &&
+             num_leaves + to_split.size() < k_) {
+        to_split.push_back(leaves.top().second);
+        leaves.pop();
+      }
+      std::vector<BisectResult> results(to_split.size());
+      std::vector<std::thread> threads;
+      for (unsigned int i = 1; i < to_split.size(); i++)
+        threads.push_back(std::thread(&KMeans::Bisect, this,
+                                      std::cref(input_data),
+                                      std::cref(members[to_split[i]]),
+                                      seed + to_split[i], &results[i]));
+      Bisect(input_data, members[to_split[0]], seed + to_split[0],
+             &results[0]);
+      for (unsigned int i = 0; i < threads.size(); i++)
+        threads[i].join();
+      for (unsigned int i = 0; i < to_split.size(); i++) {
+        int parent = to_split[i];
+        // A cluster of identical points cannot be split
+        if (results[i].members[0].empty() || results[i].members[1].empty())
+          continue;
+        for (int child = 0; child < 2; child++) {
+          int id = hierarchy_.size();
+          KMeansHierarchyNode node = {-1, -1, -1};
+          hierarchy_.push_back(node);
+          hierarchy_centers_.col(id) = results[i].centers.col(child);
+          members[id].swap(results[i].members[child]);
+          sse[id] = results[i].sse[child];
+          if (members[id].size() > 1)
+            leaves.push(std::make_pair(
+                BisectingScore(results[i].sse[child], members[id].size()),
+                id));
+          if (child == 0)
+            hierarchy_[parent].left = id;
+          else
+            hierarchy_[parent].right = id;
+        }
+        std::vector<unsigned int>().swap(members[parent]);
+        num_leaves++;
+      }
+    }
+    if (num_leaves < k_) {
+      std::stringstream ss;
+      ss << "Only " << num_leaves << " distinct clusters out of " << k_
+         << " could be found";
+      throw std::runtime_error(ss.str());
+    }
+    // Number the leaves as the final clusters
+    labels_.resize(input_data.cols());
+    centers_.resize(dim, k_);
+    sse_ = 0;
+    int cluster = 0;
+    for (unsigned int id = 0; id < hierarchy_.size(); id++) {
+      if (hierarchy_[id].left >= 0)
+        continue;
+      hierarchy_[id].cluster = cluster;
+      centers_.col(cluster) = hierarchy_centers_.col(id);
+      for (unsigned int point : members[id])
+        labels_(point) = cluster;
+      sse_ += sse[id];
+      cluster++;
+    }
+    sse_ /= input_data.cols();
+  }
+
+  // Lloyd iterations from a k-means++ seeding. They stop when no label
+  // changes, after max_iter_ iterations, when the inertia improves by a
+  // relative amount of at most tolerance_, or when less than a fraction
+  // min_reassign_fraction_ of the points changed cluster.
+  void RunIterations(const Matrix<T> &input_data, unsigned int round) {
     if (input_data.cols() < k_) {
       std::stringstream ss;
       ss << "The number of points (" << input_data.cols()
@@ -69,27 +377,47 @@ class KMeans {
     }
     // Seed a random number generator
     KMeansPPInit(input_data);
+    Lloyd(input_data, round);
+  }
 
-    // We must store the labels at the previous iteration to
-    // determine whether any labels changed at each iteration.
-    // initialize to all zeros
-    Vector<T> old_labels = Vector<T>::Zero(input_data.cols());
-
-    // Initialize the labels array
-    labels_.resize(input_data.cols());
+  // Lloyd iterations starting from the current centers_
+  void Lloyd(const Matrix<T> &input_data, unsigned int round) {
+    // No point has a cluster yet, so the first pass reassigns them all
+    labels_ = Vector<int>::Constant(input_data.cols(), -1);
     // The current iteration number
-    int iter = 0;
+    unsigned int iter = 0;
 
-    // Track whether any labels changed in the last iteration
-    bool changed = true;
+    // The assignment pass counts the points whose label changed and
+    // accumulates the SSE. Once nothing changes the new centers equal the
+    // old ones, so that SSE is also the SSE of the final centers.
+    unsigned int n = input_data.cols();
+    unsigned int changed = 0;
+    T old_inertia = std::numeric_limits<T>::infinity();
+    bool converged = false;
     do {
-      AssignLabels(input_data);
-      EstimateNewCenters(input_data);
-      changed = CheckChanged(labels_, old_labels);
-      // Save the old labels
-      old_labels = labels_;
+      iteration_log_.timer.Start();
+      if (algorithm_ == kFilterKMeans) {
+        changed = FilterLabelsAndCenters();
+      } else {
+        changed = AssignLabels(input_data);
+        EstimateNewCenters(input_data);
+      }
+      iteration_log_.timer.Stop();
+      T inertia = sse_ / n;
+      iteration_log_.round.push_back(round);
+      iteration_log_.inertia.push_back(inertia);
+      iteration_log_.reassigned.push_back(changed);
       iter++;
-    } while (changed);
+      converged = changed == 0 ||
+          (tolerance_ > 0 && old_inertia - inertia <= tolerance_ * inertia) ||
+          changed < min_reassign_fraction_ * n;
+      old_inertia = inertia;
+    } while (!converged && (max_iter_ == 0 || iter < max_iter_));
+    // After an early stop the centers moved since the last assignment,
+    // so assign once more to keep labels_ and sse_ consistent with them
+    if (changed > 0)
+      AssignLabels(input_data);
+    sse_ /= n;
   }
   T GetSSE(const Matrix<T> &input_data) {
     T sse = 0.0;
@@ -101,26 +429,20 @@ class KMeans {
   }
   unsigned int FindClosestCluster(const Vector<T>& query_point,
                                   unsigned int num_cluster) {
-    unsigned int closest_cluster = 0;
-    T min_dist = std::numeric_limits<T>::max();
-    for (unsigned int i = 0; i < num_cluster; ++i) {
-      T dist = (centers_.col(i) - query_point).norm();
-      if (dist < min_dist) {
-        min_dist = dist;
-        closest_cluster = i;
-      }
-    }
-    return closest_cluster;
+    T min_dist;
+    return FindClosestCluster<Eigen::Dynamic>(query_point.data(),
+                                              query_point.size(),
+                                              num_cluster, &min_dist);
   }
-  void AssignLabels(const Matrix<T> &input_data) {
-    // Assign each point to the closest cluster
-    for (unsigned int point = 0; point < input_data.cols(); ++point) {
-      unsigned int closest_cluster =
-          FindClosestCluster(input_data.col(point), k_);
-      labels_(point) = (T)closest_cluster;
-    }
+  // Assigns each point to the closest cluster, sets sse_ to the total
+  // squared distance and returns how many labels changed
+  unsigned int AssignLabels(const Matrix<T> &input_data) {
+    AssignLabelsOp op = {this, &input_data, k_, &labels_, 0, 0};
+    KMeansDimDispatcher<>::Dispatch(input_data.rows(), &op);
+    sse_ = op.sse;
+    return op.changed;
   }
-  std::vector<unsigned int> GetIndicesWithLabel(const T label) const {
+  std::vector<unsigned int> GetIndicesWithLabel(const int label) const {
     std::vector<unsigned int> indices_with_label;
     for (unsigned int i = 0; i < labels_.size(); i++) {
       if (labels_(i) == label) {
@@ -130,83 +452,195 @@ class KMeans {
     return indices_with_label;
   }
   void EstimateNewCenters(const Matrix<T> &input_data) {
-    Matrix<T> old_centers = centers_;
-    for (unsigned int cluster = 0; cluster < k_; ++cluster) {
-      std::vector<unsigned int> indices_with_label =
-          GetIndicesWithLabel(cluster);
-      Matrix<T> cluster_points(input_data.rows(), indices_with_label.size());
-      for (unsigned int point = 0; point < indices_with_label.size(); point++) {
-        cluster_points.col(point) = input_data.col(indices_with_label[point]);
-      }
-      Vector<T> center;
-      if (cluster_points.cols() == 0) {
-        center = old_centers.col(cluster);
-      } else {
-        center = cluster_points.rowwise().mean();
-      }
-      centers_.col(cluster) = center;
+    EstimateNewCentersOp op = {this, &input_data};
+    KMeansDimDispatcher<>::Dispatch(input_data.rows(), &op);
+  }
+  // Draws an index with probability proportional to its weight, in O(n)
+  // with a single cumulative sum. Zero weights are never drawn.
+  unsigned int SelectWeightedIndex(const Vector<T> &weights) {
+    std::vector<T> cumulative(weights.size());
+    std::partial_sum(weights.data(), weights.data() + weights.size(),
+                     cumulative.begin());
+    if (cumulative.empty() || !(cumulative.back() > 0))
+      throw std::runtime_error(
+          "SelectWeightedIndex() needs a positive total weight");
+    // Get a random value between 0 and the total weight
+    T random_value = (T)drand48() * cumulative.back();
+    unsigned int index = std::upper_bound(cumulative.begin(),
+                                          cumulative.end(), random_value) -
+        cumulative.begin();
+    // Rounding can put the value at the total, past every entry
+    if (index == cumulative.size()) {
+      index--;
+      while (weights(index) <= 0)
+        index--;
     }
+    return index;
   }
-  bool CheckChanged(const Vector<T>& labels, const Vector<T>& old_labels) {
-    bool changed = false;
-    for (unsigned int i = 0; i < labels.size(); i++) {
-      if (labels(i) != old_labels(i)) {
-        changed = true;
-        break;
-      }
+
+  void KMeansPPInit(const Matrix<T> &input_data) {
+    centers_ = KMeansPPSeeds(input_data, k_);
+  }
+
+  // Returns num_centers k-means++ seeds, the first k of which are also
+  // a k-means++ seeding for k clusters
+  Matrix<T> KMeansPPSeeds(const Matrix<T> &input_data,
+                          unsigned int num_centers) {
+    Matrix<T> seeds(input_data.rows(), num_centers);
+    // Assign one center at random
+    unsigned int random_id = rand() % input_data.cols();
+    seeds.col(0) = input_data.col(random_id);
+    // Assign the rest of the initial centers using a weighted probability
+    // of the distance to the nearest center, which only needs the
+    // distances to the newest center at every step
+    Vector<T> weights = (input_data.colwise() - seeds.col(0))
+        .colwise().squaredNorm().transpose();
+    for (unsigned int cluster = 1; cluster < num_centers; ++cluster) {
+      unsigned int selected_point_id = SelectWeightedIndex(weights);
+      seeds.col(cluster) = input_data.col(selected_point_id);
+      weights = weights.cwiseMin((input_data.colwise() - seeds.col(cluster))
+                                 .colwise().squaredNorm().transpose());
     }
-    return changed;
+    return seeds;
   }
 
-  unsigned int SelectWeightedIndex(Vector<T> weights) {
-    // Normalize
-    Vector<T> normalizedWeights = weights / weights.sum();
-    std::map<T, unsigned int> weights_index_map;
-    for (unsigned int i = 0; i < weights.size(); i++) {
-      weights_index_map[normalizedWeights(i)] = i;
+  // Fits every k in [k_min, k_max] on the same input, several k at a
+  // time on num_threads_ threads, and scores each fit with its inertia
+  // and silhouette. Under kBisectingKMeans every k is a bisecting fit and
+  // the model keeps the hierarchy of the best one. Otherwise every restart
+  // draws a single k-means++ seed chain of k_max seeds, and the fit for k
+  // runs Lloyd from its first k seeds; kFilterKMeans only speeds up these
+  // iterations, so its sweep gives the same fits. The silhouette is the
+  // simplified one (distances to centers, O(n k)) or, with
+  // SetSilhouetteSampleSize, the exact one over a random sample of points.
+  KMeansSweepResult<T> SweepK(const Matrix<T> &input_data,
+                              unsigned int k_min, unsigned int k_max) {
+    if (k_min < 1 || k_min > k_max) {
+      std::stringstream ss;
+      ss << "Invalid range of clusters [" << k_min << ", " << k_max << "]";
+      throw std::runtime_error(ss.str());
     }
-    // Sort the normalized weights
-    std::sort(normalizedWeights.data(),
-      normalizedWeights.data()+normalizedWeights.size());
-    // Get a randome value between 0 and 1
-    T random_value = (T)drand48();
+    if (static_cast<unsigned int>(input_data.rows()) < k_max) {
+      std::stringstream ss;
+      ss << "The number of points (" << input_data.rows()
+         << ") must be larger than the number of clusters (" << k_max << ")";
+      throw std::runtime_error(ss.str());
+    }
+    online_counts_.clear();
+    ClearHierarchy();
+    iteration_log_ = KMeansIterationLog<T>();
+    unsigned int t = time(NULL);
+    srand48(t);
+    srand(t);
+    Matrix<T> data = input_data.transpose();
+    std::vector<Matrix<T>> seeds;
+    if (algorithm_ != kBisectingKMeans) {
+      seeds.resize(n_init_);
+      for (unsigned int round = 0; round < n_init_; round++)
+        seeds[round] = KMeansPPSeeds(data, k_max);
+    }
+    unsigned int bisect_seed = rand();
+    unsigned int sample_seed = rand();
 
-    T running_total = 0.0;
+    unsigned int num_k = k_max - k_min + 1;
+    // Fresh models, which only get the settings of the fits
+    std::vector<KMeans<T>> models(num_k);
+    KMeansSweepResult<T> result;
+    result.k.resize(num_k);
+    result.inertia.resize(num_k);
+    result.silhouette.resize(num_k);
+    unsigned int num_threads = std::min(num_threads_, num_k);
+    std::vector<std::exception_ptr> errors(num_threads);
+    std::vector<std::thread> threads;
+    for (unsigned int i = 1; i < num_threads; i++)
+      threads.push_back(std::thread(&KMeans::SweepWorker, this,
+                                    std::cref(data), std::cref(seeds),
+                                    k_min, i, num_threads, bisect_seed,
+                                    sample_seed, &models, &result,
+                                    &errors[i]));
+    SweepWorker(data, seeds, k_min, 0, num_threads, bisect_seed,
+                sample_seed, &models, &result, &errors[0]);
+    for (unsigned int i = 0; i < threads.size(); i++)
+      threads[i].join();
+    for (unsigned int i = 0; i < num_threads; i++)
+      if (errors[i])
+        std::rethrow_exception(errors[i]);
 
-    for (unsigned int i = 0; i < normalizedWeights.size(); i++) {
-      running_total += normalizedWeights[i];
-      if (random_value < running_total) {
-        T weight = normalizedWeights(i);
-        return weights_index_map[weight];
+    unsigned int best = 0;
+    for (unsigned int i = 1; i < num_k; i++)
+      if (result.silhouette[i] > result.silhouette[best])
+        best = i;
+    result.best_k = result.k[best];
+    k_ = result.best_k;
+    labels_.swap(models[best].labels_);
+    centers_.swap(models[best].centers_);
+    iteration_log_ = models[best].iteration_log_;
+    sse_ = models[best].sse_;
+    hierarchy_.swap(models[best].hierarchy_);
+    hierarchy_centers_.swap(models[best].hierarchy_centers_);
+    Publish();
+    return result;
+  }
+
+  // The simplified silhouette of the current labels and centers: for each
+  // point a is the distance to its own center and b the distance to the
+  // closest other center. Points of a single cluster score 0.
+  T SimplifiedSilhouette(const Matrix<T> &input_data) const {
+    if (centers_.cols() < 2)
+      return 0;
+    T total = 0;
+    for (unsigned int i = 0; i < input_data.cols(); i++) {
+      T a = 0;
+      T b = std::numeric_limits<T>::max();
+      for (unsigned int c = 0; c < centers_.cols(); c++) {
+        T dist = (centers_.col(c) - input_data.col(i)).norm();
+        if (static_cast<int>(c) == labels_(i))
+          a = dist;
+        else
+          b = std::min(b, dist);
       }
+      T m = std::max(a, b);
+      if (m > 0)
+        total += (b - a) / m;
     }
-    std::cerr << "runningTotal: " << running_total << std::endl;
-    std::cerr << "randomValue: " << random_value << std::endl;
-    throw std::runtime_error(
-      "SelectWeightedIndex() reached end, we should never get here.");
+    return total / input_data.cols();
   }
 
-  void KMeansPPInit(const Matrix<T> &input_data) {
-    // Assign one center at random
-    unsigned int random_id = rand() % input_data.cols();
-    Vector<T> p = input_data.col(random_id);
-    centers_.col(0) = p;
-    // Assign the rest of the initial centers using a
-    // weighted probability of the distance to the nearest center
-    Vector<T> weights(input_data.cols());
-    for (unsigned int cluster = 1; cluster < k_; ++cluster) {
-      // Create weight vector
-      for (unsigned int i = 0; i < input_data.cols(); i++) {
-        Vector<T> current_point = input_data.col(i);
-        unsigned int closest_cluster =
-            FindClosestCluster(current_point, cluster);
-        weights(i) =
-            (centers_.col(closest_cluster) - current_point).squaredNorm();
-      }
-      unsigned int selected_point_id = SelectWeightedIndex(weights);
-      p = input_data.col(selected_point_id);
-      centers_.col(cluster) = p;
+  // The exact silhouette of the current labels averaged over sample_size
+  // random points, O(sample_size n d). Points alone in their cluster
+  // score 0.
+  T SampledSilhouette(const Matrix<T> &input_data, unsigned int sample_size,
+                      unsigned int seed) const {
+    unsigned int n = input_data.cols();
+    unsigned int k = centers_.cols();
+    if (k < 2)
+      return 0;
+    std::vector<unsigned int> counts(k, 0);
+    for (unsigned int i = 0; i < n; i++)
+      counts[labels_(i)]++;
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<unsigned int> pick(0, n - 1);
+    sample_size = std::min(sample_size, n);
+    Vector<T> sums(k);
+    T total = 0;
+    for (unsigned int s = 0; s < sample_size; s++) {
+      unsigned int i = sample_size == n ? s : pick(rng);
+      int own = labels_(i);
+      if (counts[own] < 2)
+        continue;
+      sums.setZero();
+      for (unsigned int j = 0; j < n; j++)
+        sums(labels_(j)) += (input_data.col(j) - input_data.col(i)).norm();
+      T a = sums(own) / (counts[own] - 1);
+      T b = std::numeric_limits<T>::max();
+      for (unsigned int c = 0; c < k; c++)
+        if (static_cast<int>(c) != own && counts[c] > 0)
+          b = std::min(b, sums(c) / counts[c]);
+      T m = std::max(a, b);
+      if (m > 0)
+        total += (b - a) / m;
     }
+    return total / sample_size;
   }
 
   void SetRandom(const bool r) {
@@ -217,8 +651,62 @@ class KMeans {
     this->n_init_ = n;
   }
 
+  // The maximum number of Lloyd iterations per restart, 0 for no limit
+  void SetMaxIter(unsigned int n) {
+    this->max_iter_ = n;
+  }
+
+  // Stop once an iteration improves the inertia by a relative amount
+  // of at most tol, 0 to disable
+  void SetTolerance(T tol) {
+    this->tolerance_ = tol;
+  }
+
+  // Stop once less than this fraction of the points changed cluster
+  // in an iteration, 0 to disable
+  void SetMinReassignFraction(T fraction) {
+    this->min_reassign_fraction_ = fraction;
+  }
+
+  // The Lloyd iterations of the last Fit, Run or SweepK (those of the
+  // best k), empty after a bisecting fit
+  const KMeansIterationLog<T> &GetIterationLog() const {
+    return iteration_log_;
+  }
+
+  // The number of points SweepK samples to estimate the exact silhouette,
+  // 0 to use the simplified silhouette
+  void SetSilhouetteSampleSize(unsigned int n) {
+    this->silhouette_sample_size_ = n;
+  }
+
+  void SetAlgorithm(KMeansAlgorithm algorithm) {
+    this->algorithm_ = algorithm;
+  }
+
+  void SetBisectingStrategy(KMeansBisectingStrategy strategy) {
+    this->bisecting_strategy_ = strategy;
+  }
+
+  void SetNumThreads(unsigned int n) {
+    this->num_threads_ = std::max(n, 1u);
+  }
+
+  const std::vector<KMeansHierarchyNode> &GetHierarchy() const {
+    return hierarchy_;
+  }
+
+  Matrix<T> GetHierarchyCenters() {
+    return hierarchy_centers_;
+  }
+
   Matrix <T> GetLabels() {
-    return labels_;
+    return labels_.cast<T>();
+  }
+
+  // The mean squared distance of the points to their centers
+  T GetInertia() const {
+    return sse_;
   }
 
   Matrix <T> GetCenters() {
@@ -226,20 +714,504 @@ class KMeans {
   }
 
   Matrix <T> Predict(const Matrix<T> &input_data) {
-    Vector<T> labels_new_data_;
+    Vector<int> labels_new_data_ =
+        Vector<int>::Constant(input_data.rows(), -1);
+    if (algorithm_ == kLloydKMeans) {
+      // Assign each point to the closest cluster
+      GetServingPredictor()->Predict(input_data, labels_new_data_.data());
+      return labels_new_data_.cast<T>();
+    }
     Matrix<T> data = input_data.transpose();
-    labels_new_data_.resize(data.cols());
-    // Assign each point to the closest cluster
-    for (unsigned int point = 0; point < data.cols(); ++point) {
-      unsigned int closest_cluster =
-          FindClosestCluster(data.col(point), k_);
-      labels_new_data_(point) = (T)closest_cluster;
+    if (algorithm_ == kBisectingKMeans) {
+      std::shared_ptr<const ServingHierarchy> hierarchy =
+          std::atomic_load(&serving_hierarchy_);
+      // Centers published without a hierarchy, by SweepK, are flat
+      if (!hierarchy) {
+        GetServingPredictor()->Predict(input_data, labels_new_data_.data());
+        return labels_new_data_.cast<T>();
+      }
+      // Descend the center hierarchy towards the closer child, which
+      // is approximate but takes O(log k) distance computations
+      const std::vector<KMeansHierarchyNode> &nodes = hierarchy->nodes;
+      const Matrix<T> &centers = hierarchy->centers;
+      for (unsigned int point = 0; point < data.cols(); ++point) {
+        int node = 0;
+        while (nodes[node].left >= 0) {
+          int left = nodes[node].left;
+          int right = nodes[node].right;
+          T left_dist = (centers.col(left) - data.col(point)).squaredNorm();
+          T right_dist = (centers.col(right) - data.col(point)).squaredNorm();
+          node = left_dist <= right_dist ? left : right;
+        }
+        labels_new_data_(point) = nodes[node].cluster;
+      }
+      return labels_new_data_.cast<T>();
     }
-    return labels_new_data_;
+    if (algorithm_ == kFilterKMeans) {
+      // Answer the nearest center queries with the published kd-tree over
+      // the centers
+      std::shared_ptr<const KdTree<T>> center_tree = GetServingTree();
+      for (unsigned int point = 0; point < data.cols(); ++point) {
+        T min_dist;
+        labels_new_data_(point) =
+            center_tree->FindNearest(data.col(point).data(), &min_dist);
+      }
+    }
+    return labels_new_data_.cast<T>();
+  }
+
+  // A predictor of the published centers for low-latency serving
+  KMeansPredictor<T> GetPredictor() const {
+    return *GetServingPredictor();
+  }
+
+  // Makes the Lloyd Predict path and GetPredictor answer through an HNSW
+  // index over the centers, m = 0 to use exact search. The index is
+  // rebuilt whenever centers are published, including every PartialFit.
+  void SetHnswPredict(int m, int ef_construction = 200, int ef = 50) {
+    this->hnsw_m_ = m;
+    this->hnsw_ef_construction_ = ef_construction;
+    this->hnsw_ef_ = ef;
+    if (centers_.cols() > 0)
+      Publish();
+  }
+
+  // The weight of the past batches in PartialFit, 1 for plain running
+  // means
+  void SetDecay(T decay) {
+    this->decay_ = decay;
+  }
+
+  // PartialFit re-seeds centers whose count is below this fraction of
+  // the mean count, 0 to disable
+  void SetReseedFraction(T fraction) {
+    this->reseed_fraction_ = fraction;
   }
 
  private:
-  Vector<T> labels_;
+  // The center hierarchy as last published for concurrent Predict
+  struct ServingHierarchy {
+    std::vector<KMeansHierarchyNode> nodes;
+    Matrix<T> centers;
+  };
+
+  // Drops the center hierarchy of an earlier bisecting fit
+  void ClearHierarchy() {
+    hierarchy_.clear();
+    hierarchy_centers_.resize(0, 0);
+  }
+
+  // Makes the current centers, and the center hierarchy if there is one,
+  // visible to Predict and GetPredictor
+  void Publish() {
+    std::shared_ptr<KMeansPredictor<T>> predictor =
+        std::make_shared<KMeansPredictor<T>>(centers_);
+    if (hnsw_m_ > 0)
+      predictor->UseHnsw(hnsw_m_, hnsw_ef_construction_, hnsw_ef_);
+    std::atomic_store(&serving_,
+                      std::shared_ptr<const KMeansPredictor<T>>(predictor));
+    std::shared_ptr<KdTree<T>> tree;
+    if (algorithm_ == kFilterKMeans) {
+      tree = std::make_shared<KdTree<T>>(1);
+      tree->Build(centers_);
+    }
+    std::atomic_store(&serving_tree_,
+                      std::shared_ptr<const KdTree<T>>(tree));
+    std::shared_ptr<ServingHierarchy> hierarchy;
+    if (!hierarchy_.empty()) {
+      hierarchy = std::make_shared<ServingHierarchy>();
+      hierarchy->nodes = hierarchy_;
+      hierarchy->centers = hierarchy_centers_;
+    }
+    std::atomic_store(&serving_hierarchy_,
+                      std::shared_ptr<const ServingHierarchy>(hierarchy));
+  }
+
+  std::shared_ptr<const KMeansPredictor<T>> GetServingPredictor() const {
+    std::shared_ptr<const KMeansPredictor<T>> predictor =
+        std::atomic_load(&serving_);
+    if (!predictor)
+      predictor = std::make_shared<KMeansPredictor<T>>(centers_);
+    return predictor;
+  }
+
+  // The published kd-tree over the centers, built here when the centers
+  // were published under another algorithm
+  std::shared_ptr<const KdTree<T>> GetServingTree() const {
+    std::shared_ptr<const KdTree<T>> tree = std::atomic_load(&serving_tree_);
+    if (!tree) {
+      std::shared_ptr<KdTree<T>> built = std::make_shared<KdTree<T>>(1);
+      built->Build(GetServingPredictor()->GetCenters());
+      tree = built;
+    }
+    return tree;
+  }
+
+  // Fits the k of every num_threads-th entry of models, starting at
+  // first, by bisecting or from the given seed chains, and scores it into
+  // result. An exception is kept in error for the calling thread.
+  void SweepWorker(const Matrix<T> &data, const std::vector<Matrix<T>> &seeds,
+                   unsigned int k_min, unsigned int first,
+                   unsigned int num_threads, unsigned int bisect_seed,
+                   unsigned int sample_seed, std::vector<KMeans<T>> *models,
+                   KMeansSweepResult<T> *result,
+                   std::exception_ptr *error) const {
+    try {
+      for (unsigned int i = first; i < models->size(); i += num_threads)
+        SweepFit(data, seeds, k_min + i, bisect_seed, sample_seed,
+                 &(*models)[i], result, i);
+    } catch (...) {
+      *error = std::current_exception();
+    }
+  }
+
+  // Fits k clusters into the fresh model fit and scores it into entry i
+  // of result
+  void SweepFit(const Matrix<T> &data, const std::vector<Matrix<T>> &seeds,
+                unsigned int k, unsigned int bisect_seed,
+                unsigned int sample_seed, KMeans<T> *fit,
+                KMeansSweepResult<T> *result, unsigned int i) const {
+    KMeans<T> &model = *fit;
+    model.k_ = k;
+    model.max_iter_ = max_iter_;
+    model.tolerance_ = tolerance_;
+    model.min_reassign_fraction_ = min_reassign_fraction_;
+    if (algorithm_ == kBisectingKMeans) {
+      model.algorithm_ = kBisectingKMeans;
+      model.n_init_ = n_init_;
+      model.bisecting_strategy_ = bisecting_strategy_;
+      // The sweep already keeps the threads busy
+      model.num_threads_ = 1;
+      model.RunBisecting(data, bisect_seed);
+    } else {
+      T best_sse = std::numeric_limits<T>::infinity();
+      Vector<int> best_labels;
+      Matrix<T> best_centers;
+      for (unsigned int round = 0; round < seeds.size(); round++) {
+        model.centers_ = seeds[round].leftCols(k);
+        model.Lloyd(data, round);
+        if (model.sse_ < best_sse) {
+          best_sse = model.sse_;
+          best_labels = model.labels_;
+          best_centers = model.centers_;
+        }
+      }
+      model.labels_ = best_labels;
+      model.centers_ = best_centers;
+      model.sse_ = best_sse;
+    }
+    result->k[i] = k;
+    result->inertia[i] = model.sse_;
+    if (silhouette_sample_size_ > 0)
+      result->silhouette[i] = model.SampledSilhouette(
+          data, silhouette_sample_size_, sample_seed);
+    else
+      result->silhouette[i] = model.SimplifiedSilhouette(data);
+  }
+
+  struct BisectResult {
+    std::vector<unsigned int> members[2];
+    Matrix<T> centers;
+    T sse[2];
+  };
+
+  T BisectingScore(T sse, unsigned int size) const {
+    if (bisecting_strategy_ == kBisectLargestCluster)
+      return (T)size;
+    return sse;
+  }
+
+  // Splits the points of input_data listed in members with 2-means,
+  // keeping the best of n_init_ k-means++ seeded runs. It only uses its
+  // own random generator so that several splits can run concurrently.
+  void Bisect(const Matrix<T> &input_data,
+              const std::vector<unsigned int> &members, unsigned int seed,
+              BisectResult *result) const {
+    int dim = input_data.rows();
+    int n = members.size();
+    Matrix<T> points(dim, n);
+    for (int i = 0; i < n; i++)
+      points.col(i) = input_data.col(members[i]);
+    std::mt19937 rng(seed);
+    std::vector<unsigned char> labels(n), best_labels;
+    Matrix<T> centers(dim, 2);
+    T best_sse = std::numeric_limits<T>::infinity();
+    Vector<T> weights(n);
+    for (unsigned int round = 0; round < n_init_; round++) {
+      // k-means++ seeding of the two centers
+      centers.col(0) = points.col(
+          std::uniform_int_distribution<int>(0, n - 1)(rng));
+      weights = (points.colwise() - centers.col(0)).colwise().squaredNorm();
+      if (weights.sum() <= 0)
+        break;
+      std::discrete_distribution<int> pick(weights.data(),
+                                           weights.data() + n);
+      centers.col(1) = points.col(pick(rng));
+      bool changed = true;
+      for (unsigned int iter = 0;
+           changed && (max_iter_ == 0 || iter < max_iter_); iter++) {
+        changed = false;
+        for (int i = 0; i < n; i++) {
+          unsigned char label =
+              (centers.col(1) - points.col(i)).squaredNorm() <
+              (centers.col(0) - points.col(i)).squaredNorm();
+          if (iter == 0 || label != labels[i]) {
+            labels[i] = label;
+            changed = true;
+          }
+        }
+        Matrix<T> sums = Matrix<T>::Zero(dim, 2);
+        int counts[2] = {0, 0};
+        for (int i = 0; i < n; i++) {
+          sums.col(labels[i]) += points.col(i);
+          counts[labels[i]]++;
+        }
+        for (int c = 0; c < 2; c++)
+          if (counts[c] > 0)
+            centers.col(c) = sums.col(c) / (T)counts[c];
+      }
+      T sse = 0;
+      for (int i = 0; i < n; i++)
+        sse += (centers.col(labels[i]) - points.col(i)).squaredNorm();
+      if (sse < best_sse) {
+        best_sse = sse;
+        best_labels = labels;
+        result->centers = centers;
+      }
+    }
+    for (int c = 0; c < 2; c++) {
+      result->members[c].clear();
+      result->sse[c] = 0;
+    }
+    if (best_labels.empty())
+      return;
+    for (int i = 0; i < n; i++) {
+      result->members[best_labels[i]].push_back(members[i]);
+      result->sse[best_labels[i]] +=
+          (result->centers.col(best_labels[i]) - points.col(i))
+          .squaredNorm();
+    }
+  }
+
+  // One Lloyd iteration with the filtering algorithm of Kanungo et al.
+  // Cells of tree_ whose points all share the same closest center are
+  // assigned at once using the cell sums, without any distance computation.
+  // Returns how many labels changed and sets sse_ like AssignLabels.
+  unsigned int FilterLabelsAndCenters() {
+    int dim = centers_.rows();
+    filter_sums_ = Matrix<T>::Zero(dim, k_);
+    filter_counts_.assign(k_, 0);
+    filter_changed_ = 0;
+    sse_ = 0;
+    std::vector<unsigned int> candidates(k_);
+    for (unsigned int i = 0; i < k_; i++)
+      candidates[i] = i;
+    Filter(0, candidates);
+    for (unsigned int cluster = 0; cluster < k_; ++cluster) {
+      if (filter_counts_[cluster] > 0)
+        centers_.col(cluster) =
+            filter_sums_.col(cluster) / (T)filter_counts_[cluster];
+    }
+    return filter_changed_;
+  }
+
+  void Filter(int node, const std::vector<unsigned int> &candidates) {
+    const typename KdTree<T>::Node &cell = tree_.GetNode(node);
+    const Matrix<T> &points = tree_.Points();
+    if (tree_.IsLeaf(node)) {
+      for (int i = cell.begin; i < cell.end; i++) {
+        unsigned int closest = candidates[0];
+        T min_dist = std::numeric_limits<T>::max();
+        for (unsigned int c : candidates) {
+          T dist = (centers_.col(c) - points.col(i)).squaredNorm();
+          if (dist < min_dist) {
+            min_dist = dist;
+            closest = c;
+          }
+        }
+        int &label = labels_(tree_.Index(i));
+        if (label != static_cast<int>(closest)) {
+          label = closest;
+          filter_changed_++;
+        }
+        sse_ += min_dist;
+        filter_sums_.col(closest) += points.col(i);
+        filter_counts_[closest]++;
+      }
+      return;
+    }
+    // Find the candidate closest to the cell midpoint
+    Vector<T> lower = tree_.Lower().col(node);
+    Vector<T> upper = tree_.Upper().col(node);
+    Vector<T> mid = (lower + upper) / 2;
+    unsigned int best = candidates[0];
+    T min_dist = std::numeric_limits<T>::max();
+    for (unsigned int c : candidates) {
+      T dist = (centers_.col(c) - mid).squaredNorm();
+      if (dist < min_dist) {
+        min_dist = dist;
+        best = c;
+      }
+    }
+    // Drop every candidate that is farther than best from the whole cell,
+    // which holds when it is farther at the cell vertex extreme in the
+    // direction from best to the candidate
+    std::vector<unsigned int> kept;
+    kept.reserve(candidates.size());
+    for (unsigned int c : candidates) {
+      if (c == best) {
+        kept.push_back(c);
+        continue;
+      }
+      T candidate_dist = 0;
+      T best_dist = 0;
+      for (int j = 0; j < lower.size(); j++) {
+        T v = centers_(j, c) > centers_(j, best) ? upper(j) : lower(j);
+        candidate_dist += (centers_(j, c) - v) * (centers_(j, c) - v);
+        best_dist += (centers_(j, best) - v) * (centers_(j, best) - v);
+      }
+      if (candidate_dist < best_dist)
+        kept.push_back(c);
+    }
+    if (kept.size() == 1) {
+      for (int i = cell.begin; i < cell.end; i++) {
+        int &label = labels_(tree_.Index(i));
+        if (label != static_cast<int>(best)) {
+          label = best;
+          filter_changed_++;
+        }
+      }
+      // sum |x - c|^2 = sum |x|^2 - 2 c . sum x + count |c|^2
+      sse_ += tree_.SumSquares()(node) -
+          2 * centers_.col(best).dot(tree_.Sum().col(node)) +
+          tree_.Count(node) * centers_.col(best).squaredNorm();
+      filter_sums_.col(best) += tree_.Sum().col(node);
+      filter_counts_[best] += tree_.Count(node);
+      return;
+    }
+    Filter(cell.left, kept);
+    Filter(cell.right, kept);
+  }
+
+  // Returns the closest of the first num_cluster centers to the dim
+  // dimensional point stored at query_point, and its squared distance
+  template<int Dim>
+  unsigned int FindClosestCluster(const T *query_point, int dim,
+                                  unsigned int num_cluster, T *min_dist) {
+    typedef Eigen::Matrix<T, Dim, 1> Point;
+    Eigen::Map<const Point> point(query_point, dim);
+    unsigned int closest_cluster = 0;
+    *min_dist = std::numeric_limits<T>::max();
+    for (unsigned int i = 0; i < num_cluster; ++i) {
+      Eigen::Map<const Point> center(centers_.data() + i * dim, dim);
+      T dist = (center - point).squaredNorm();
+      if (dist < *min_dist) {
+        *min_dist = dist;
+        closest_cluster = i;
+      }
+    }
+    return closest_cluster;
+  }
+
+  // Labels every column of input_data with its closest center among the
+  // first num_cluster ones.
+  // Returns the number of labels that changed and the total squared
+  // distance in sse.
+  template<int Dim>
+  unsigned int AssignLabelsFixed(const Matrix<T> &input_data,
+                                 unsigned int num_cluster,
+                                 Vector<int> *labels, T *sse) {
+    int dim = input_data.rows();
+    unsigned int changed = 0;
+    T total = 0;
+    for (unsigned int point = 0; point < input_data.cols(); ++point) {
+      T min_dist;
+      int closest_cluster = FindClosestCluster<Dim>(
+          input_data.data() + point * dim, dim, num_cluster, &min_dist);
+      if ((*labels)(point) != closest_cluster) {
+        (*labels)(point) = closest_cluster;
+        changed++;
+      }
+      total += min_dist;
+    }
+    *sse = total;
+    return changed;
+  }
+
+  // Recomputes every center as the mean of its points in a single pass
+  // over the data. A center that loses all its points stays where it is.
+  template<int Dim>
+  void EstimateNewCentersFixed(const Matrix<T> &input_data) {
+    typedef Eigen::Matrix<T, Dim, 1> Point;
+    int dim = input_data.rows();
+    Matrix<T> sums = Matrix<T>::Zero(dim, k_);
+    std::vector<unsigned int> counts(k_, 0);
+    for (unsigned int point = 0; point < input_data.cols(); ++point) {
+      unsigned int cluster = labels_(point);
+      Eigen::Map<Point> sum(sums.data() + cluster * dim, dim);
+      sum += Eigen::Map<const Point>(input_data.data() + point * dim, dim);
+      counts[cluster]++;
+    }
+    for (unsigned int cluster = 0; cluster < k_; ++cluster) {
+      if (counts[cluster] > 0)
+        centers_.col(cluster) = sums.col(cluster) / (T)counts[cluster];
+    }
+  }
+
+  struct AssignLabelsOp {
+    KMeans *kmeans;
+    const Matrix<T> *input_data;
+    unsigned int num_cluster;
+    Vector<int> *labels;
+    unsigned int changed;
+    T sse;
+    template<int Dim>
+    void Run() {
+      changed = kmeans->template AssignLabelsFixed<Dim>(
+          *input_data, num_cluster, labels, &sse);
+    }
+  };
+
+  struct EstimateNewCentersOp {
+    KMeans *kmeans;
+    const Matrix<T> *input_data;
+    template<int Dim>
+    void Run() {
+      kmeans->template EstimateNewCentersFixed<Dim>(*input_data);
+    }
+  };
+
+  Vector<int> labels_;
+  KMeansAlgorithm algorithm_ = kLloydKMeans;
+  KMeansBisectingStrategy bisecting_strategy_ = kBisectHighestSSECluster;
+  unsigned int num_threads_ = std::max(std::thread::hardware_concurrency(), 1u);
+  // The center hierarchy built by kBisectingKMeans
+  std::vector<KMeansHierarchyNode> hierarchy_;
+  Matrix<T> hierarchy_centers_;
+  // The kd-tree over the points used by kFilterKMeans
+  KdTree<T> tree_;
+  Matrix<T> filter_sums_;
+  std::vector<unsigned int> filter_counts_;
+  unsigned int filter_changed_;
+  unsigned int max_iter_ = 300;
+  T tolerance_ = 0;
+  T min_reassign_fraction_ = 0;
+  KMeansIterationLog<T> iteration_log_;
+  unsigned int silhouette_sample_size_ = 0;
+  // The decayed number of points of every center in PartialFit
+  std::vector<T> online_counts_;
+  T decay_ = 1;
+  T reseed_fraction_ = 0;
+  int hnsw_m_ = 0;
+  int hnsw_ef_construction_ = 200;
+  int hnsw_ef_ = 50;
+  // The centers as last published for concurrent Predict
+  std::shared_ptr<const KMeansPredictor<T>> serving_;
+  // The kd-tree over the published centers for the kFilterKMeans Predict
+  std::shared_ptr<const KdTree<T>> serving_tree_;
+  // The center hierarchy published by the last bisecting fit, null once
+  // flat centers were published
+  std::shared_ptr<const ServingHierarchy> serving_hierarchy_;
   bool random_ = true;
   unsigned int n_init_ = 10;
   T sse_ = 0.0;
@@ -0,0 +1,184 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Northeastern University
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef CPP_INCLUDE_KMEANS_PREDICTOR_H_
+#define CPP_INCLUDE_KMEANS_PREDICTOR_H_
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <thread>  // NOLINT(build/c++11)
+#include "include/matrix.h"
+#include "include/vector.h"
+#include "include/hnsw_index.h"
+
+namespace Nice {
+
+// Nearest-center labelling for serving a fitted KMeans model. The closest
+// center minimizes |c|^2 / 2 - x . c, so the center half norms are kept and
+// a block of rows is labelled with a single matrix product against the
+// centers stored as a k x d matrix. Labels are written to a caller-provided
+// buffer, and the per-thread scratch block is allocated once per thread.
+// Predict and PredictOne can be called concurrently.
+template<typename T>
+class KMeansPredictor {
+ public:
+  // Rows labelled by one matrix product
+  static const int kBlockRows = 64;
+
+  KMeansPredictor() : num_threads_(1), min_rows_per_thread_(256) {}
+
+  // centers holds one center per column, as KMeans::GetCenters
+  explicit KMeansPredictor(const Matrix<T> &centers)
+      : num_threads_(1), min_rows_per_thread_(256) {
+    SetCenters(centers);
+  }
+
+  void SetCenters(const Matrix<T> &centers) {
+    centers_ = centers;
+    centers_t_ = centers.transpose();
+    half_norms_ = centers.colwise().squaredNorm().transpose() / 2;
+    hnsw_.reset();
+  }
+
+  // Answers queries approximately through an HNSW index over the centers,
+  // which pays off once there are many thousands of clusters
+  void UseHnsw(int m, int ef_construction, int ef) {
+    std::shared_ptr<HnswIndex<T>> hnsw =
+        std::make_shared<HnswIndex<T>>(m, ef_construction);
+    hnsw->SetEf(ef);
+    hnsw->Build(centers_);
+    hnsw_ = hnsw;
+  }
+
+  // Batches are split over up to n threads, each getting at least
+  // min_rows_per_thread rows
+  void SetNumThreads(unsigned int n, int min_rows_per_thread = 256) {
+    num_threads_ = std::max(n, 1u);
+    min_rows_per_thread_ = std::max(min_rows_per_thread, 1);
+  }
+
+  int NumClusters() const {
+    return centers_.cols();
+  }
+
+  const Matrix<T> &GetCenters() const {
+    return centers_;
+  }
+
+  // Labels the single point x, of the dimension of the centers, without
+  // any allocation, and optionally returns its squared distance
+  int PredictOne(const T *x, T *min_dist = NULL) const {
+    if (hnsw_) {
+      T dist;
+      int closest = hnsw_->FindNearest(x, &dist);
+      if (min_dist != NULL)
+        *min_dist = dist;
+      return closest;
+    }
+    Eigen::Map<const Vector<T>> point(x, centers_.rows());
+    int closest = 0;
+    T best = std::numeric_limits<T>::max();
+    for (int c = 0; c < centers_.cols(); c++) {
+      T score = half_norms_(c) - centers_.col(c).dot(point);
+      if (score < best) {
+        best = score;
+        closest = c;
+      }
+    }
+    if (min_dist != NULL)
+      *min_dist = std::max(T(0), 2 * best + point.squaredNorm());
+    return closest;
+  }
+
+  // Labels every row of input_data (one point per row, as KMeans::Predict)
+  // into labels, which must hold input_data.rows() entries. Single points
+  // are faster through PredictOne.
+  template<typename Derived>
+  void Predict(const Eigen::MatrixBase<Derived> &input_data,
+               int *labels) const {
+    int n = input_data.rows();
+    int num_threads = std::min<int>(num_threads_,
+                                    n / min_rows_per_thread_);
+    if (num_threads <= 1) {
+      PredictRows(input_data, 0, n, labels);
+      return;
+    }
+    // Contiguous ranges of whole blocks for every thread
+    int blocks = (n + kBlockRows - 1) / kBlockRows;
+    int blocks_per_thread = (blocks + num_threads - 1) / num_threads;
+    std::vector<std::thread> threads;
+    for (int t = 1; t < num_threads; t++) {
+      int begin = std::min(n, t * blocks_per_thread * kBlockRows);
+      int end = std::min(n, (t + 1) * blocks_per_thread * kBlockRows);
+      if (begin < end)
+        threads.push_back(std::thread(
+            &KMeansPredictor::PredictRows<Derived>, this,
+            std::cref(input_data), begin, end, labels));
+    }
+    PredictRows(input_data, 0,
+                std::min(n, blocks_per_thread * kBlockRows), labels);
+    for (unsigned int t = 0; t < threads.size(); t++)
+      threads[t].join();
+  }
+
+ private:
+  template<typename Derived>
+  void PredictRows(const Eigen::MatrixBase<Derived> &input_data,
+                   int begin, int end, int *labels) const {
+    if (hnsw_) {
+      Vector<T> point(input_data.cols());
+      for (int row = begin; row < end; row++) {
+        point = input_data.row(row).transpose();
+        labels[row] = PredictOne(point.data());
+      }
+      return;
+    }
+    static thread_local Matrix<T> scores;
+    if (scores.rows() != centers_t_.rows() || scores.cols() != kBlockRows)
+      scores.resize(centers_t_.rows(), kBlockRows);
+    for (int row = begin; row < end; row += kBlockRows) {
+      int rows = std::min(kBlockRows, end - row);
+      scores.leftCols(rows).noalias() =
+          centers_t_ * input_data.middleRows(row, rows).transpose();
+      for (int i = 0; i < rows; i++)
+        (half_norms_ - scores.col(i)).minCoeff(&labels[row + i]);
+    }
+  }
+
+  unsigned int num_threads_;
+  int min_rows_per_thread_;
+  // One center per column, for single points
+  Matrix<T> centers_;
+  // One center per row, for blocks of points
+  Matrix<T> centers_t_;
+  Vector<T> half_norms_;
+  std::shared_ptr<const HnswIndex<T>> hnsw_;
+};
+
+template<typename T>
+const int KMeansPredictor<T>::kBlockRows;
+
+}  // namespace Nice
+
+#endif  // CPP_INCLUDE_KMEANS_PREDICTOR_H_
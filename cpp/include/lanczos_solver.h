@@ -0,0 +1,279 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Northeastern University
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef CPP_INCLUDE_LANCZOS_SOLVER_H_
+#define CPP_INCLUDE_LANCZOS_SOLVER_H_
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include "Eigen/Dense"
+#include "include/matrix.h"
+#include "include/vector.h"
+
+namespace Nice {
+
+// The end of the spectrum found by LanczosSolver
+enum LanczosWhich {
+  kLargestEigenvalues = 0,
+  kSmallestEigenvalues
+};
+
+// Finds a few extreme eigenpairs of a symmetric operator that is only
+// available through products y = A x, with the restarted block Lanczos
+// method. The Krylov basis of m vectors is fully reorthogonalized, and is
+// restarted by keeping the best Ritz vectors and the residual block (thick
+// restart, Wu and Simon 2000, which for symmetric operators is equivalent
+// to the implicit restart of ARPACK). With a block size b > 1 the
+// operator is applied to n x b blocks, which suits operators that are
+// cheaper per vector on blocks and eigenvalues of multiplicity up to b.
+// The iterations stop once every residual |A x - lambda x| is below the
+// tolerance times max(1, |lambda|), or after the maximum number of
+// restarts.
+template<typename T>
+class LanczosSolver {
+ public:
+  // Stores A x in y for the n x b block x; y is already n x b
+  typedef std::function<void(const Matrix<T> &x, Matrix<T> *y)> Operator;
+
+  LanczosSolver()
+      : which_(kLargestEigenvalues), block_size_(1), num_vectors_(0),
+        max_restarts_(1000), tolerance_(1e-6), seed_(0), num_restarts_(0),
+        num_operations_(0) {}
+
+  void SetWhich(LanczosWhich which) {
+    which_ = which;
+  }
+
+  void SetBlockSize(int b) {
+    block_size_ = std::max(b, 1);
+  }
+
+  // The size m of the Krylov basis, by default max(2k + b, 20) rounded to
+  // a multiple of b, and at most n
+  void SetNumLanczosVectors(int m) {
+    num_vectors_ = m;
+  }
+
+  void SetMaxRestarts(int n) {
+    max_restarts_ = n;
+  }
+
+  void SetTolerance(T tol) {
+    tolerance_ = tol;
+  }
+
+  // The seed of the random starting block
+  void SetSeed(unsigned int seed) {
+    seed_ = seed;
+  }
+
+  /// Computes k eigenpairs of the symmetric n x n operator a
+  ///
+  /// \param a
+  /// The products with the operator
+  ///
+  /// \param n
+  /// The dimension of the operator
+  ///
+  /// \param k
+  /// The number of eigenpairs
+  ///
+  /// \return
+  /// Void
+  void Compute(const Operator &a, int n, int k) {
+    int b = std::min(block_size_, n);
+    int m = num_vectors_ > 0 ? num_vectors_ : std::max(2 * k + b, 20);
+    m = std::min((m + b - 1) / b * b, n / b * b);
+    if (k < 1 || k + b > m) {
+      std::stringstream ss;
+      ss << "Lanczos needs k + b <= m <= n, got k = " << k << ", b = " << b
+         << ", m = " << m << ", n = " << n;
+      throw std::runtime_error(ss.str());
+    }
+    std::mt19937 rng(seed_);
+    num_operations_ = 0;
+    // The basis, its projection h = v^T A v, and the block a_block of
+    // products with the last block
+    Matrix<T> v(n, m);
+    Matrix<T> h = Matrix<T>::Zero(m, m);
+    Matrix<T> block(n, b), a_block(n, b);
+    v.leftCols(b) = RandomBlock(v, 0, n, b, &rng);
+    int size = b;
+    for (num_restarts_ = 0; ; num_restarts_++) {
+      // Extends the basis to m vectors, and leaves the orthonormalized
+      // residual block in block with its coefficients in coupling
+      Matrix<T> coupling(b, b);
+      for (int last = size - b; ; last += b) {
+        block = v.middleCols(last, b);
+        a(block, &a_block);
+        num_operations_++;
+        T reference = a_block.norm();
+        Matrix<T> coefficients = Orthogonalize(v, size, &a_block);
+        h.block(0, last, size, b) = coefficients;
+        h.block(last, 0, b, size) = coefficients.transpose();
+        coupling = Normalize(v, size, reference, &a_block, &rng);
+        if (size == m)
+          break;
+        v.middleCols(size, b) = a_block;
+        h.block(size, last, b, b) = coupling;
+        h.block(last, size, b, b) = coupling.transpose();
+        size += b;
+      }
+      // Ritz pairs, with the wanted ones first
+      Eigen::SelfAdjointEigenSolver<Matrix<T>> ritz(h);
+      Matrix<T> s = ritz.eigenvectors();
+      Vector<T> theta = ritz.eigenvalues();
+      if (which_ == kLargestEigenvalues) {
+        s = s.rowwise().reverse().eval();
+        theta = theta.reverse().eval();
+      }
+      // The residual of the Ritz vector v s_i is the residual block
+      // times coupling s_i restricted to the last block
+      Matrix<T> tail = coupling * s.bottomRows(b);
+      eigenvalues_ = theta.head(k);
+      residuals_ = tail.leftCols(k).colwise().norm().transpose();
+      bool done = Converged() || num_restarts_ >= max_restarts_;
+      // Thick restart from the best Ritz vectors, at least k and at
+      // most m - b
+      int keep = done ? k : std::min(k + (m - k) / 2, m - b);
+      keep = std::max(keep, k);
+      Matrix<T> kept = v * s.leftCols(keep);
+      if (done) {
+        eigenvectors_ = kept;
+        break;
+      }
+      v.leftCols(keep) = kept;
+      v.middleCols(keep, b) = a_block;
+      h.setZero();
+      h.diagonal().head(keep) = theta.head(keep);
+      h.block(keep, 0, b, keep) = tail.leftCols(keep);
+      h.block(0, keep, keep, b) = tail.leftCols(keep).transpose();
+      size = keep + b;
+    }
+  }
+
+  /// Computes k eigenpairs of the symmetric dense or sparse matrix a
+  template<typename MatrixType>
+  void Compute(const MatrixType &a, int k) {
+    Compute([&a](const Matrix<T> &x, Matrix<T> *y) { y->noalias() = a * x; },
+            a.rows(), k);
+  }
+
+  /// The eigenvalues, from the largest or the smallest
+  Vector<T> Eigenvalues() const {
+    return eigenvalues_;
+  }
+
+  /// The eigenvectors, one per column in the order of Eigenvalues
+  Matrix<T> Eigenvectors() const {
+    return eigenvectors_;
+  }
+
+  /// The residual |A x - lambda x| of every eigenpair
+  Vector<T> Residuals() const {
+    return residuals_;
+  }
+
+  int GetNumRestarts() const {
+    return num_restarts_;
+  }
+
+  /// The number of block products with the operator
+  int GetNumOperations() const {
+    return num_operations_;
+  }
+
+  /// Whether every residual is within the tolerance
+  bool Converged() const {
+    for (int j = 0; j < residuals_.size(); j++)
+      if (residuals_(j) > tolerance_ *
+          std::max(T(1), std::abs(eigenvalues_(j))))
+        return false;
+    return true;
+  }
+
+ private:
+  // Orthogonalizes x against the first size columns of v, twice for
+  // stability, and returns the coefficients
+  static Matrix<T> Orthogonalize(const Matrix<T> &v, int size,
+                                 Matrix<T> *x) {
+    Matrix<T> coefficients = v.leftCols(size).transpose() * (*x);
+    x->noalias() -= v.leftCols(size) * coefficients;
+    Matrix<T> correction = v.leftCols(size).transpose() * (*x);
+    x->noalias() -= v.leftCols(size) * correction;
+    return coefficients + correction;
+  }
+
+  // Replaces x, orthogonal to the first size columns of v, by an
+  // orthonormal basis q with x = q r, and returns r. When x vanishes the
+  // Krylov space is invariant, and q is a new random block with r = 0.
+  // reference is the norm of x before the orthogonalization.
+  static Matrix<T> Normalize(const Matrix<T> &v, int size, T reference,
+                             Matrix<T> *x, std::mt19937 *rng) {
+    int b = x->cols();
+    if (x->norm() <= 100 * std::numeric_limits<T>::epsilon() * reference) {
+      *x = RandomBlock(v, size, x->rows(), b, rng);
+      return Matrix<T>::Zero(b, b);
+    }
+    Eigen::HouseholderQR<Matrix<T>> qr(*x);
+    Matrix<T> r = qr.matrixQR().topRows(b).template triangularView<
+        Eigen::Upper>();
+    *x = qr.householderQ() * Matrix<T>::Identity(x->rows(), b);
+    return r;
+  }
+
+  // A random orthonormal n x b block orthogonal to the first size columns
+  // of v
+  static Matrix<T> RandomBlock(const Matrix<T> &v, int size, int n, int b,
+                               std::mt19937 *rng) {
+    std::normal_distribution<T> normal;
+    Matrix<T> x(n, b);
+    for (int j = 0; j < b; j++)
+      for (int i = 0; i < n; i++)
+        x(i, j) = normal(*rng);
+    if (size > 0)
+      Orthogonalize(v, size, &x);
+    Eigen::HouseholderQR<Matrix<T>> qr(x);
+    return qr.householderQ() * Matrix<T>::Identity(n, b);
+  }
+
+  LanczosWhich which_;
+  int block_size_;
+  int num_vectors_;
+  int max_restarts_;
+  T tolerance_;
+  unsigned int seed_;
+  int num_restarts_;
+  int num_operations_;
+  Vector<T> eigenvalues_;
+  Matrix<T> eigenvectors_;
+  Vector<T> residuals_;
+};
+
+}  // namespace Nice
+
+#endif  // CPP_INCLUDE_LANCZOS_SOLVER_H_
@@ -28,6 +28,7 @@
 #include <cmath>
 #include "include/matrix.h"
 #include "include/vector.h"
+#include "include/cpu_operations.h"
 #include "Eigen/Dense"
 
 namespace Nice {
@@ -78,11 +79,10 @@ class LinearRegression {
     return final_error;
   }
   void MaximumLikelihoodEstimation(const Matrix<T> &X, const Matrix<T> &Y) {
-    Matrix<T> xTransposed = X.transpose();
-    Matrix<T> thetaPart1 = xTransposed*X;
-    Matrix<T> thetaPart1Inv = thetaPart1.inverse();
-    Vector<T> thetaPart2 = xTransposed*Y;
-    theta_ = thetaPart1Inv*thetaPart2;
+    // The least squares solution of X theta = Y, from a QR factorization of
+    // X rather than the inverse of X^T X
+    typename CpuOperations<T>::Solver solver(X, kQrFactorization);
+    theta_ = solver.Solve(Y);
   }
   void GradientDescent(const Matrix<T> &X, const Matrix<T> &Y) {
     Vector<T> delta_;
@@ -0,0 +1,221 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Northeastern University
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef CPP_INCLUDE_LOBPCG_SOLVER_H_
+#define CPP_INCLUDE_LOBPCG_SOLVER_H_
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include "Eigen/Dense"
+#include "include/matrix.h"
+#include "include/vector.h"
+
+namespace Nice {
+
+// Computes the k smallest eigenpairs of a symmetric matrix with the
+// locally optimal block preconditioned conjugate gradient method (Knyazev,
+// 2001). The matrix is only used through products with n x k blocks, so it
+// can be a dense Matrix<T> or an Eigen::SparseMatrix<T>. The iterations
+// stop once every residual |A x - lambda x| is below the tolerance times
+// max(1, |lambda|), or after the maximum number of iterations; the
+// residuals are kept so that accuracy can be traded for speed.
+template<typename T>
+class LobpcgSolver {
+ public:
+  LobpcgSolver()
+      : max_iter_(500), tolerance_(1e-4), seed_(0), num_iter_(0) {}
+
+  void SetMaxIter(int n) {
+    max_iter_ = n;
+  }
+
+  void SetTolerance(T tol) {
+    tolerance_ = tol;
+  }
+
+  // The seed of the random starting block
+  void SetSeed(unsigned int seed) {
+    seed_ = seed;
+  }
+
+  /// Computes the k smallest eigenpairs of the symmetric matrix a
+  ///
+  /// \param a
+  /// A symmetric dense or sparse matrix
+  ///
+  /// \param k
+  /// The number of eigenpairs
+  ///
+  /// \return
+  /// Void
+  template<typename MatrixType>
+  void Compute(const MatrixType &a, int k) {
+    std::mt19937 rng(seed_);
+    std::normal_distribution<T> normal;
+    Matrix<T> x(a.rows(), k);
+    for (int j = 0; j < k; j++)
+      for (int i = 0; i < a.rows(); i++)
+        x(i, j) = normal(rng);
+    Compute(a, x);
+  }
+
+  /// Computes the eigenpairs of the symmetric matrix a starting from an
+  /// approximation of the eigenvectors, such as the ones of a coarser
+  /// problem
+  ///
+  /// \param a
+  /// A symmetric dense or sparse matrix
+  ///
+  /// \param x0
+  /// The starting block, one vector per column
+  ///
+  /// \return
+  /// Void
+  template<typename MatrixType>
+  void Compute(const MatrixType &a, const Matrix<T> &x0) {
+    int n = a.rows();
+    int k = x0.cols();
+    if (a.cols() != n || x0.rows() != n || k < 1 || 3 * k > n) {
+      std::stringstream ss;
+      ss << "LOBPCG needs a square matrix with at least 3k rows and a "
+         << "starting block of as many rows, got " << a.rows() << " x "
+         << a.cols() << " and " << x0.rows() << " x " << k;
+      throw std::runtime_error(ss.str());
+    }
+    // Jacobi preconditioner when the diagonal is positive
+    Vector<T> precond = a.diagonal();
+    if (precond.minCoeff() > 0)
+      precond = precond.cwiseInverse();
+    else
+      precond.setOnes();
+
+    Matrix<T> x = Orthonormalize(x0);
+    Matrix<T> ax = a * x;
+    Matrix<T> p(n, 0), ap(n, 0);
+    // Rayleigh-Ritz on the starting block
+    Eigen::SelfAdjointEigenSolver<Matrix<T>> small(x.transpose() * ax);
+    x = x * small.eigenvectors();
+    ax = ax * small.eigenvectors();
+    eigenvalues_ = small.eigenvalues();
+
+    for (num_iter_ = 1; ; num_iter_++) {
+      Matrix<T> r = ax - x * eigenvalues_.asDiagonal();
+      residuals_ = r.colwise().norm().transpose();
+      if (Converged() || num_iter_ >= max_iter_)
+        break;
+      Matrix<T> w = precond.asDiagonal() * r;
+      Matrix<T> aw = a * w;
+      // The search space [x, w, p], and its image by a
+      int m = x.cols() + w.cols() + p.cols();
+      Matrix<T> s(n, m), as(n, m);
+      s << x, w, p;
+      as << ax, aw, ap;
+      // An orthonormal basis s * b of the search space, dropping the
+      // directions lost to round-off
+      Vector<T> scale = s.colwise().norm().transpose();
+      for (int j = 0; j < m; j++)
+        scale(j) = scale(j) > 0 ? 1 / scale(j) : 0;
+      Matrix<T> gram = scale.asDiagonal() * (s.transpose() * s) *
+          scale.asDiagonal();
+      Eigen::SelfAdjointEigenSolver<Matrix<T>> basis(gram);
+      T cutoff = basis.eigenvalues().maxCoeff() *
+          std::sqrt(std::numeric_limits<T>::epsilon());
+      int dropped = 0;
+      while (dropped < m && basis.eigenvalues()(dropped) <= cutoff)
+        dropped++;
+      int kept = m - dropped;
+      if (kept < k)
+        break;
+      Matrix<T> b = scale.asDiagonal() *
+          basis.eigenvectors().rightCols(kept) *
+          basis.eigenvalues().tail(kept).cwiseSqrt().cwiseInverse()
+              .asDiagonal();
+      Matrix<T> h = b.transpose() * (s.transpose() * as) * b;
+      h = (h + h.transpose()) / 2;
+      small.compute(h);
+      Matrix<T> z = b * small.eigenvectors().leftCols(k);
+      eigenvalues_ = small.eigenvalues().head(k);
+      // The new directions are the w and p parts of the new block
+      int rest = m - k;
+      p = s.rightCols(rest) * z.bottomRows(rest);
+      ap = as.rightCols(rest) * z.bottomRows(rest);
+      x = s * z;
+      ax = as * z;
+    }
+    // The image of x was updated implicitly, so the reported residuals
+    // are computed again
+    ax = a * x;
+    residuals_ = (ax - x * eigenvalues_.asDiagonal()).colwise().norm()
+        .transpose();
+    eigenvectors_ = x;
+  }
+
+  /// The k smallest eigenvalues in increasing order
+  Vector<T> Eigenvalues() const {
+    return eigenvalues_;
+  }
+
+  /// The eigenvectors, one per column in the order of Eigenvalues
+  Matrix<T> Eigenvectors() const {
+    return eigenvectors_;
+  }
+
+  /// The residual |A x - lambda x| of every eigenpair
+  Vector<T> Residuals() const {
+    return residuals_;
+  }
+
+  int GetNumIter() const {
+    return num_iter_;
+  }
+
+  /// Whether every residual is within the tolerance
+  bool Converged() const {
+    for (int j = 0; j < residuals_.size(); j++)
+      if (residuals_(j) > tolerance_ *
+          std::max(T(1), std::abs(eigenvalues_(j))))
+        return false;
+    return true;
+  }
+
+ private:
+  static Matrix<T> Orthonormalize(const Matrix<T> &x) {
+    Eigen::HouseholderQR<Matrix<T>> qr(x);
+    return qr.householderQ() * Matrix<T>::Identity(x.rows(), x.cols());
+  }
+
+  int max_iter_;
+  T tolerance_;
+  unsigned int seed_;
+  int num_iter_;
+  Vector<T> eigenvalues_;
+  Matrix<T> eigenvectors_;
+  Vector<T> residuals_;
+};
+
+}  // namespace Nice
+
+#endif  // CPP_INCLUDE_LOBPCG_SOLVER_H_
@@ -0,0 +1,236 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Northeastern University
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// This header needs MPI and is only built with -Denable-mpi=ON
+
+#ifndef CPP_INCLUDE_MPI_KMEANS_H_
+#define CPP_INCLUDE_MPI_KMEANS_H_
+
+#include <mpi.h>
+#include <algorithm>
+#include <vector>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include "include/matrix.h"
+#include "include/vector.h"
+#include "include/kmeans_predictor.h"
+
+namespace Nice {
+
+template<typename T>
+struct MpiType;
+
+template<>
+struct MpiType<float> {
+  static MPI_Datatype Get() { return MPI_FLOAT; }
+};
+
+template<>
+struct MpiType<double> {
+  static MPI_Datatype Get() { return MPI_DOUBLE; }
+};
+
+// KMeans over a data set sharded by rows across the ranks of an MPI
+// communicator. Every rank calls Fit collectively with its own rows; the
+// ranks assign their points locally and allreduce the per-center sums,
+// counts, reassignments and SSE every Lloyd iteration, so each one ends
+// with the same centers and the labels of its own rows.
+template<typename T>
+class MpiKMeans {
+ public:
+  explicit MpiKMeans(MPI_Comm comm = MPI_COMM_WORLD)
+      : comm_(comm), n_init_(10), max_iter_(300), seed_(100), k_(0),
+        sse_(0) {}
+
+  void SetNInit(int n) {
+    n_init_ = n;
+  }
+
+  void SetMaxIter(unsigned int n) {
+    max_iter_ = n;
+  }
+
+  // The seed of the random choices, which all happen on rank 0
+  void SetSeed(unsigned int seed) {
+    seed_ = seed;
+  }
+
+  // input_data holds the rows of this rank, one point per row
+  void Fit(const Matrix<T> &input_data, int k) {
+    k_ = k;
+    Matrix<T> data = input_data.transpose();
+    long local_n = data.cols();  // NOLINT(runtime/int)
+    long n = 0;  // NOLINT(runtime/int)
+    MPI_Allreduce(&local_n, &n, 1, MPI_LONG, MPI_SUM, comm_);
+    if (n < k_) {
+      std::stringstream ss;
+      ss << "The number of points (" << n
+         << ") must be larger than the number of clusters (" << k_ << ")";
+      throw std::runtime_error(ss.str());
+    }
+    rng_.seed(seed_);
+    T best_sse = std::numeric_limits<T>::infinity();
+    Matrix<T> best_centers;
+    Vector<int> best_labels;
+    for (int round = 0; round < n_init_; round++) {
+      Seed(data);
+      Lloyd(data, n);
+      if (sse_ < best_sse) {
+        best_sse = sse_;
+        best_centers = centers_;
+        best_labels = labels_;
+      }
+    }
+    centers_ = best_centers;
+    labels_ = best_labels;
+    sse_ = best_sse;
+  }
+
+  // The labels of the rows of this rank
+  Matrix<T> GetLabels() {
+    return labels_.cast<T>();
+  }
+
+  Matrix<T> GetCenters() {
+    return centers_;
+  }
+
+  // The mean squared distance of all the points to their centers
+  T GetInertia() const {
+    return sse_;
+  }
+
+  unsigned int GetNumIter() const {
+    return num_iter_;
+  }
+
+ private:
+  // Distributed k-means++: rank 0 draws where the next seed falls in the
+  // global D^2 weights, and the rank owning that point broadcasts it
+  void Seed(const Matrix<T> &data) {
+    int rank, size;
+    MPI_Comm_rank(comm_, &rank);
+    MPI_Comm_size(comm_, &size);
+    int dim = data.rows();
+    centers_.resize(dim, k_);
+    Vector<T> weights = Vector<T>::Constant(data.cols(), 1);
+    std::vector<T> local_sums(size);
+    Vector<T> seed(dim);
+    for (int c = 0; c < k_; c++) {
+      T local_sum = weights.sum();
+      MPI_Allgather(&local_sum, 1, MpiType<T>::Get(), local_sums.data(), 1,
+                    MpiType<T>::Get(), comm_);
+      T total = 0;
+      for (int r = 0; r < size; r++)
+        total += local_sums[r];
+      T target = 0;
+      if (rank == 0)
+        target = std::uniform_real_distribution<T>(0, total)(rng_);
+      MPI_Bcast(&target, 1, MpiType<T>::Get(), 0, comm_);
+      // Every rank finds the owner the same way
+      int owner = size - 1;
+      while (owner > 0 && local_sums[owner] <= 0)
+        owner--;
+      for (int r = 0; r < size; r++) {
+        if (local_sums[r] > 0 && target < local_sums[r]) {
+          owner = r;
+          break;
+        }
+        target -= local_sums[r];
+      }
+      if (rank == owner) {
+        int point = data.cols() - 1;
+        for (int i = 0; i < data.cols(); i++) {
+          if (weights(i) > 0 && target < weights(i)) {
+            point = i;
+            break;
+          }
+          target -= weights(i);
+        }
+        seed = data.col(point);
+      }
+      MPI_Bcast(seed.data(), dim, MpiType<T>::Get(), owner, comm_);
+      centers_.col(c) = seed;
+      Vector<T> dist = (data.colwise() - seed).colwise().squaredNorm()
+          .transpose();
+      weights = c == 0 ? dist : Vector<T>(weights.cwiseMin(dist));
+    }
+  }
+
+  void Lloyd(const Matrix<T> &data, long n) {  // NOLINT(runtime/int)
+    int dim = data.rows();
+    labels_ = Vector<int>::Constant(data.cols(), -1);
+    Vector<int> labels(data.cols());
+    // The sums of the points of every center, then the SSE
+    Vector<T> local(dim * k_ + 1);
+    Vector<T> global(local.size());
+    // The number of points of every center, then the number of reassigned
+    // points, as integers so that they stay exact beyond 2^24 in float
+    std::vector<long> local_counts(k_ + 1);  // NOLINT(runtime/int)
+    std::vector<long> global_counts(k_ + 1);  // NOLINT(runtime/int)
+    for (num_iter_ = 1; ; num_iter_++) {
+      KMeansPredictor<T> predictor(centers_);
+      predictor.Predict(data.transpose(), labels.data());
+      local.setZero();
+      std::fill(local_counts.begin(), local_counts.end(), 0);
+      for (int i = 0; i < data.cols(); i++) {
+        int c = labels(i);
+        local.segment(c * dim, dim) += data.col(i);
+        local_counts[c]++;
+        if (labels(i) != labels_(i))
+          local_counts[k_]++;
+        local(dim * k_) += (centers_.col(c) - data.col(i)).squaredNorm();
+      }
+      labels_ = labels;
+      MPI_Allreduce(local.data(), global.data(), local.size(),
+                    MpiType<T>::Get(), MPI_SUM, comm_);
+      MPI_Allreduce(local_counts.data(), global_counts.data(), k_ + 1,
+                    MPI_LONG, MPI_SUM, comm_);
+      sse_ = global(dim * k_) / n;
+      if (global_counts[k_] == 0 ||
+          (max_iter_ > 0 && num_iter_ >= max_iter_))
+        break;
+      for (int c = 0; c < k_; c++) {
+        if (global_counts[c] > 0)
+          centers_.col(c) = global.segment(c * dim, dim) /
+              static_cast<T>(global_counts[c]);
+      }
+    }
+  }
+
+  MPI_Comm comm_;
+  int n_init_;
+  unsigned int max_iter_;
+  unsigned int seed_;
+  int k_;
+  T sse_;
+  unsigned int num_iter_;
+  std::mt19937 rng_;
+  Matrix<T> centers_;
+  Vector<int> labels_;
+};
+
+}  // namespace Nice
+
+#endif  // CPP_INCLUDE_MPI_KMEANS_H_
@@ -24,69 +24,252 @@
 #define CPP_INCLUDE_SPECTRAL_CLUSTERING_H_
 
 #include <Eigen/Dense>
+#include <Eigen/Sparse>
 #include <vector>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+#include <thread>  // NOLINT(build/c++11)
 #include "include/matrix.h"
 #include "include/vector.h"
 #include "include/kmeans.h"
-#include "include/svd_solver.h"
+#include "include/kd_tree.h"
+#include "include/hnsw_index.h"
+#include "include/graph_coarsening.h"
+#include "include/lobpcg_solver.h"
 
 namespace Nice {
 
+// How SpectralClustering finds the eigenvectors of the smallest
+// eigenvalues of the Laplacian
+enum SpectralEigenSolver {
+  // A full dense eigen decomposition, which holds a second n x n matrix
+  // for the eigenvectors and densifies sparse graphs
+  kDenseEigenSolver = 0,
+  // LOBPCG iterations on k vectors only
+  kLobpcgEigenSolver,
+  // Power iteration clustering (Lin and Cohen, 2010): k vectors truncated
+  // early in the power iteration of D^-1 W, in O(iterations nnz(W)),
+  // instead of eigenvectors
+  kPowerIteration
+};
+
+// The graph Laplacian of SpectralClustering
+enum SpectralLaplacian {
+  // L = D - W
+  kUnnormalizedLaplacian = 0,
+  // L = I - D^-1/2 W D^-1/2, with the rows of the embedding normalized
+  // (Ng, Jordan and Weiss, 2002)
+  kSymmetricLaplacian,
+  // L = I - D^-1 W (Shi and Malik, 2000)
+  kRandomWalkLaplacian
+};
+
+// The similarity graph of SpectralClustering
+enum SpectralGraph {
+  // Every pair of points, a dense n x n graph
+  kFullyConnectedGraph = 0,
+  // Points where either is among the nearest neighbours of the other
+  kKnnGraph,
+  // Points where each is among the nearest neighbours of the other
+  kMutualKnnGraph,
+  // Points closer than epsilon
+  kEpsilonGraph,
+  // Landmark-based spectral clustering (Chen and Cai, 2011): every point
+  // is connected to its nearest landmarks only, and the embedding comes
+  // from the SVD of that n x p graph in O(n p) time and memory
+  kLandmarkGraph
+};
+
+// How kLandmarkGraph picks its landmarks
+enum SpectralLandmarks {
+  // A random sample of the points
+  kRandomLandmarks = 0,
+  // The centers of a few KMeans iterations
+  kKMeansLandmarks
+};
+
+// Spectral clustering. With the fully connected graph, the
+// similarity graph, and then the Laplacian computed in place from it, are
+// the only n x n buffers kept; the other graphs are sparse, found through
+// a kd-tree (or an HNSW index, see SetHnswGraph) on several threads, and
+// take O(n m) memory for m neighbours.
+// The degrees are a vector and only the k eigenvectors of the smallest
+// eigenvalues are computed, by LOBPCG by default. kDenseEigenSolver, also
+// used when n < 3 k, computes all n eigenvectors instead: that is a
+// second n x n matrix, plus a dense copy of a sparse Laplacian.
 template<typename T>
 class SpectralClustering {
  public:
   SpectralClustering()
       :
-      sigma_(1.0), kmeans_(), svd_() {}
+      sigma_(1.0), eigen_solver_(kLobpcgEigenSolver),
+      laplacian_type_(kUnnormalizedLaplacian), power_tolerance_(1e-5),
+      power_max_iter_(1000), graph_(kFullyConnectedGraph),
+      num_neighbors_(10), epsilon_(1), num_landmarks_(1000),
+      num_nearest_landmarks_(5), landmarks_type_(kKMeansLandmarks),
+      num_threads_(std::max(std::thread::hardware_concurrency(), 1u)),
+      coarse_size_(0), refine_iterations_(10), hnsw_m_(0),
+      hnsw_ef_construction_(200), hnsw_ef_(50), dense_graph_(true),
+      kmeans_(), lobpcg_(), fitted_() {}
 
   void Fit(const Matrix<T> &input_data, int k) {
     k_ = k;
-    SimilarityGraph(input_data);
-    ComputeLaplacian();
-    int n_ = similarity_.rows();
-    u_.resize(n_, n_);
-    y_.resize(n_, k_);
-    svd_.Compute(laplacian_);
-    u_ = svd_.MatrixV();
-    y_ = u_.block(0, n_ - k_, n_, k_);
-    kmeans_.Fit(y_, k_);
-    labels_.resize(n_, 1);
+    int n = input_data.rows();
+    if (graph_ == kLandmarkGraph)
+      LandmarkEmbedding(input_data);
+    else
+      GraphEmbedding(input_data);
+    RecordFit(graph_);
+    FitKMeans();
+    labels_.resize(n, 1);
+    labels_ = kmeans_.GetLabels();
+  }
+  // Clusters the nodes of the given symmetric sparse affinity graph
+  void FitGraph(const Eigen::SparseMatrix<T> &affinity, int k) {
+    k_ = k;
+    laplacian_.resize(0, 0);
+    points_.resize(0, 0);
+    ClearLandmarks();
+    sparse_laplacian_ = affinity;
+    degrees_ = affinity * Vector<T>::Ones(affinity.rows());
+    dense_graph_ = false;
+    SpectralEmbedding();
+    // A sparse graph without points, which Predict rejects
+    RecordFit(kKnnGraph);
+    FitKMeans();
     labels_ = kmeans_.GetLabels();
   }
   void SetSigma(T s) {
     sigma_ = s;
   }
+  // LOBPCG falls back to the dense solver when there are fewer than 3k
+  // points
+  void SetEigenSolver(SpectralEigenSolver solver) {
+    eigen_solver_ = solver;
+  }
+  // The LOBPCG residual tolerance, relative to max(1, |lambda|)
+  void SetEigenTolerance(T tol) {
+    lobpcg_.SetTolerance(tol);
+  }
+  void SetEigenMaxIter(int n) {
+    lobpcg_.SetMaxIter(n);
+  }
+  void SetLaplacian(SpectralLaplacian laplacian) {
+    laplacian_type_ = laplacian;
+  }
+  // kPowerIteration stops once the step of every vector varies by less
+  // than tol / n from one iteration to the next, or after max_iter
+  // iterations
+  void SetPowerIteration(T tol, int max_iter) {
+    power_tolerance_ = tol;
+    power_max_iter_ = max_iter;
+  }
+  void SetGraph(SpectralGraph graph) {
+    graph_ = graph;
+  }
+  // The number of neighbours of the kNN graphs
+  void SetNumNeighbors(int n) {
+    num_neighbors_ = n;
+  }
+  // The distance below which points are connected in the epsilon graph
+  void SetEpsilon(T epsilon) {
+    epsilon_ = epsilon;
+  }
+  // kLandmarkGraph uses num_landmarks landmarks (at most n, and with
+  // kKMeansLandmarks at most the number of distinct points) and connects
+  // every point to its num_nearest closest ones
+  void SetLandmarks(int num_landmarks, int num_nearest,
+                    SpectralLandmarks landmarks = kKMeansLandmarks) {
+    if (num_nearest < 1) {
+      std::stringstream ss;
+      ss << "The number of nearest landmarks (" << num_nearest
+         << ") must be at least 1";
+      throw std::runtime_error(ss.str());
+    }
+    num_landmarks_ = num_landmarks;
+    num_nearest_landmarks_ = num_nearest;
+    landmarks_type_ = landmarks;
+  }
+  // With the sparse graphs and FitGraph, coarsens the graph by heavy-edge
+  // matching down to about coarse_size nodes, finds the eigenvectors of
+  // the coarsest graph, and then interpolates them level by level,
+  // refining them with refine_iterations LOBPCG iterations per level.
+  // 0 disables the multilevel scheme.
+  void SetMultilevel(int coarse_size, int refine_iterations = 10) {
+    coarse_size_ = coarse_size;
+    refine_iterations_ = refine_iterations;
+  }
+  // Finds the neighbours of the kNN graphs, and of new points in Predict,
+  // with an HNSW index over the points instead of the exact kd-tree,
+  // which is faster in high dimensions. m = 0 uses the kd-tree; the
+  // epsilon graph always does.
+  void SetHnswGraph(int m, int ef_construction = 200, int ef = 50) {
+    hnsw_m_ = m;
+    hnsw_ef_construction_ = ef_construction;
+    hnsw_ef_ = ef;
+  }
+  // The threads building the sparse graphs
+  void SetNumThreads(unsigned int n) {
+    num_threads_ = std::max(n, 1u);
+  }
+  // Stores the similarity graph of the rows of input_data, and the
+  // degree of every row
   void SimilarityGraph(const Matrix<T> &input_data) {
+    dense_graph_ = graph_ == kFullyConnectedGraph;
+    if (!dense_graph_) {
+      laplacian_.resize(0, 0);
+      SparseSimilarityGraph(input_data);
+      degrees_ = sparse_laplacian_ * Vector<T>::Ones(input_data.rows());
+      return;
+    }
+    sparse_laplacian_.resize(0, 0);
+    points_ = input_data.transpose();
     int rows = input_data.rows();
-    similarity_.resize(rows, rows);
-    degrees_.resize(rows, rows);
+    laplacian_.resize(rows, rows);
     for (int i = 0; i < rows; i++) {
-      for (int j = 0; j < rows; j++) {
-        degrees_(i, j) = 0;
+      for (int j = i; j < rows; j++) {
+        T sim = exp(0 - (input_data.row(i) - input_data.row(j)).norm())
+            / (2 * sigma_);
+        laplacian_(i, j) = sim;
+        laplacian_(j, i) = sim;
       }
     }
-    int counter = 0;
-    for (int i = 0; i < rows; i++) {
-      for (int j = counter; j < rows; j++) {
-        Vector<T> x_i = input_data.row(i);
-        Vector<T> x_j = input_data.row(j);
-        double sim = exp(0 - (x_i - x_j).norm()) / (2 * sigma_);
-        similarity_(i, j) = sim;
-        similarity_(j, i) = sim;
+    degrees_ = laplacian_.rowwise().sum();
+  }
+  // Turns the similarity graph into the Laplacian in place. Both
+  // normalized Laplacians are computed as I - D^-1/2 W D^-1/2, the
+  // eigenvectors of the random walk one are scaled back in Fit.
+  void ComputeLaplacian() {
+    int n = degrees_.size();
+    Vector<T> diagonal = degrees_;
+    if (laplacian_type_ != kUnnormalizedLaplacian) {
+      Vector<T> scale = InvSqrtDegrees();
+      diagonal.setOnes();
+      if (!dense_graph_) {
+        Eigen::SparseMatrix<T> scaled =
+            scale.asDiagonal() * sparse_laplacian_ * scale.asDiagonal();
+        sparse_laplacian_.swap(scaled);
+      } else {
+        laplacian_.array().colwise() *= scale.array();
+        laplacian_.array().rowwise() *= scale.transpose().array();
       }
-      counter++;
     }
-    for (int i = 0; i < rows; i++) {
-      T sum = 0;
-      for (int j = 0; j < rows; j++) {
-        sum += similarity_(i, j);
-      }
-      degrees_(i, i) = sum;
+    if (!dense_graph_) {
+      std::vector<Eigen::Triplet<T>> triplets;
+      triplets.reserve(n);
+      for (int i = 0; i < n; i++)
+        triplets.push_back(Eigen::Triplet<T>(i, i, diagonal(i)));
+      Eigen::SparseMatrix<T> degrees(n, n);
+      degrees.setFromTriplets(triplets.begin(), triplets.end());
+      sparse_laplacian_ = degrees - sparse_laplacian_;
+      return;
     }
-  }
-  void ComputeLaplacian() {
-    laplacian_.resize(similarity_.rows(), similarity_.rows());
-    laplacian_ = degrees_ - similarity_;
+    laplacian_ *= -1;
+    laplacian_.diagonal() += diagonal;
   }
   Matrix<T> FitPredict(const Matrix<T> &input_data, int k) {
     Fit(input_data, k);
@@ -95,17 +278,539 @@ class SpectralClustering {
   Matrix<T> GetLabels() {
     return labels_;
   }
+  // Labels the rows of input_data without fitting again. The new points
+  // are embedded with the Nystrom extension of the fitted eigenvectors:
+  // from the Laplacian equations, a new point x gets
+  // y(x) = sum_j w(x, x_j) y_j / (d_x - lambda) for D - W, with the
+  // similarities w to the training points of the graph (all of them, its
+  // kNN or the ones closer than epsilon) and its degree d_x, and the
+  // analogous forms for the normalized Laplacians and kPowerIteration.
+  // With kLandmarkGraph only the nearest landmarks are used. The points
+  // are then labelled with the closest fitted KMeans center.
+  Matrix<T> Predict(const Matrix<T> &input_data) {
+    if (y_.rows() == 0) {
+      throw std::runtime_error("SpectralClustering must be fitted first");
+    }
+    int dim = fitted_.graph == kLandmarkGraph ? landmarks_.rows()
+                                               : points_.rows();
+    if (dim == 0) {
+      throw std::runtime_error("Predict needs a model fitted on points");
+    }
+    if (input_data.cols() != dim) {
+      std::stringstream ss;
+      ss << "The points have " << input_data.cols()
+         << " dimensions, the model has " << dim;
+      throw std::runtime_error(ss.str());
+    }
+    Matrix<T> points = input_data.transpose();
+    Matrix<T> embedding(points.cols(), k_);
+    std::vector<typename KdTree<T>::Neighbor> neighbors;
+    for (int i = 0; i < points.cols(); i++) {
+      Vector<T> row = Vector<T>::Zero(k_);
+      if (fitted_.graph == kLandmarkGraph) {
+        tree_.FindKNearest(points.col(i).data(),
+                           std::min<int>(fitted_.num_nearest_landmarks,
+                                         landmarks_.cols()),
+                           &neighbors);
+        std::vector<Eigen::Triplet<T>> z;
+        AddLandmarkRow(0, neighbors, &z);
+        for (unsigned int j = 0; j < z.size(); j++)
+          row += z[j].value() * landmark_scale_(z[j].col()) *
+              projection_.row(z[j].col()).transpose();
+      } else {
+        row = Extend(points.col(i), &neighbors);
+      }
+      embedding.row(i) = row.transpose();
+    }
+    return kmeans_.Predict(embedding);
+  }
+  // The k smallest eigenvalues of the Laplacian found by the last Fit,
+  // empty with kPowerIteration and kLandmarkGraph
+  Vector<T> GetEigenvalues() {
+    return eigenvalues_;
+  }
+  // The residual |L y - lambda y| of every eigenvector of the last Fit
+  Vector<T> GetEigenResiduals() {
+    return eigen_residuals_;
+  }
 
  private:
+  // The Nystrom embedding of the new point x
+  Vector<T> Extend(const Vector<T> &x,
+                   std::vector<typename KdTree<T>::Neighbor> *neighbors) {
+    if (fitted_.graph == kFullyConnectedGraph) {
+      neighbors->clear();
+      for (int j = 0; j < points_.cols(); j++)
+        neighbors->push_back(typename KdTree<T>::Neighbor(
+            (points_.col(j) - x).squaredNorm(), j));
+    } else if (fitted_.graph == kEpsilonGraph) {
+      tree_.FindInRadius(x.data(), fitted_.epsilon * fitted_.epsilon,
+                         neighbors);
+    } else if (fitted_.hnsw) {
+      *neighbors = hnsw_.Search(x.data(), fitted_.num_neighbors);
+    } else {
+      tree_.FindKNearest(x.data(), fitted_.num_neighbors, neighbors);
+    }
+    bool symmetric = fitted_.eigen_solver != kPowerIteration &&
+        fitted_.laplacian == kSymmetricLaplacian;
+    Vector<T> row = Vector<T>::Zero(k_);
+    T degree = 0;
+    for (unsigned int j = 0; j < neighbors->size(); j++) {
+      int point = (*neighbors)[j].second;
+      T sim = exp(0 - std::sqrt((*neighbors)[j].first)) / (2 * fitted_.sigma);
+      degree += sim;
+      if (symmetric)
+        sim = degrees_(point) > 0 ? sim / std::sqrt(degrees_(point)) : 0;
+      row += sim * y_.row(point).transpose();
+    }
+    if (degree <= 0)
+      return row;
+    for (int j = 0; j < k_; j++) {
+      T lambda = eigenvalues_.size() > 0 ? eigenvalues_(j) : 0;
+      T denominator;
+      if (fitted_.eigen_solver == kPowerIteration)
+        denominator = degree;
+      else if (fitted_.laplacian == kUnnormalizedLaplacian)
+        denominator = degree - lambda;
+      else if (fitted_.laplacian == kRandomWalkLaplacian)
+        denominator = degree * (1 - lambda);
+      else
+        denominator = std::sqrt(degree) * (1 - lambda);
+      row(j) = denominator > 0 ? row(j) / denominator : 0;
+    }
+    if (symmetric && row.norm() > 0)
+      row.normalize();
+    return row;
+  }
+
+  // Stores in y_ the embedding from the similarity graph
+  void GraphEmbedding(const Matrix<T> &input_data) {
+    ClearLandmarks();
+    SimilarityGraph(input_data);
+    SpectralEmbedding();
+  }
+
+  // Stores in y_ the embedding of the similarity graph stored in
+  // laplacian_ or sparse_laplacian_
+  void SpectralEmbedding() {
+    if (eigen_solver_ == kPowerIteration) {
+      if (dense_graph_)
+        PowerIteration(laplacian_);
+      else
+        PowerIteration(sparse_laplacian_);
+      return;
+    }
+    if (dense_graph_) {
+      ComputeLaplacian();
+      SmallestEigenvectors(laplacian_);
+    } else if (coarse_size_ > 0) {
+      MultilevelEigenvectors();
+    } else {
+      ComputeLaplacian();
+      SmallestEigenvectors(sparse_laplacian_);
+    }
+    // The eigenvectors of I - D^-1 W are D^-1/2 times those of the
+    // symmetric Laplacian
+    if (laplacian_type_ == kRandomWalkLaplacian)
+      y_ = InvSqrtDegrees().asDiagonal() * y_;
+  }
+
+  // Clusters the rows of the embedding. y_ keeps the eigenvectors for
+  // the Nystrom extension, and the symmetric Laplacian clusters a row
+  // normalized copy of them, like Extend does for new points.
+  void FitKMeans() {
+    if (fitted_.graph == kLandmarkGraph ||
+        fitted_.eigen_solver == kPowerIteration ||
+        fitted_.laplacian != kSymmetricLaplacian) {
+      kmeans_.Fit(y_, k_);
+      return;
+    }
+    Matrix<T> normalized = y_;
+    for (int i = 0; i < normalized.rows(); i++) {
+      T norm = normalized.row(i).norm();
+      if (norm > 0)
+        normalized.row(i) /= norm;
+    }
+    kmeans_.Fit(normalized, k_);
+  }
+
+  // The multilevel version of ComputeLaplacian and SmallestEigenvectors
+  // on the sparse graph. The eigenvectors are interpolated as random walk
+  // eigenvectors, which are close to constant on merged nodes.
+  void MultilevelEigenvectors() {
+    GraphCoarsening<T> coarsening;
+    coarsening.Coarsen(sparse_laplacian_, coarse_size_);
+    int top = coarsening.NumLevels() - 1;
+    // Only the Laplacian of the current level is kept
+    Eigen::SparseMatrix<T> graph;
+    if (top > 0) {
+      graph.swap(sparse_laplacian_);
+      sparse_laplacian_ = coarsening.Graph(top);
+      degrees_ = sparse_laplacian_ * Vector<T>::Ones(sparse_laplacian_.rows());
+    }
+    ComputeLaplacian();
+    SmallestEigenvectors(sparse_laplacian_);
+    bool normalized = laplacian_type_ != kUnnormalizedLaplacian;
+    LobpcgSolver<T> refine = lobpcg_;
+    refine.SetMaxIter(refine_iterations_);
+    for (int level = top - 1; level >= 0; level--) {
+      if (normalized)
+        y_ = InvSqrtDegrees().asDiagonal() * y_;
+      y_ = coarsening.Prolongation(level) * y_;
+      if (level > 0)
+        sparse_laplacian_ = coarsening.Graph(level);
+      else
+        sparse_laplacian_.swap(graph);
+      degrees_ = sparse_laplacian_ * Vector<T>::Ones(sparse_laplacian_.rows());
+      ComputeLaplacian();
+      if (normalized)
+        y_ = degrees_.cwiseSqrt().asDiagonal() * y_;
+      if (3 * k_ > y_.rows()) {
+        SmallestEigenvectors(sparse_laplacian_);
+        continue;
+      }
+      refine.Compute(sparse_laplacian_, y_);
+      y_ = refine.Eigenvectors();
+      eigenvalues_ = refine.Eigenvalues();
+      eigen_residuals_ = refine.Residuals();
+    }
+  }
+
+  // Stores in y_ the k leading left singular vectors of the landmark
+  // graph Z D^-1/2, where Z holds the normalized similarities of every
+  // point to its nearest landmarks and D the landmark degrees
+  void LandmarkEmbedding(const Matrix<T> &input_data) {
+    int n = input_data.rows();
+    int p = std::min(num_landmarks_, n);
+    Matrix<T> points = input_data.transpose();
+    // k-means++ cannot seed more centers than there are distinct points,
+    // which are then all landmarks
+    std::vector<int> distinct;
+    if (landmarks_type_ == kKMeansLandmarks) {
+      distinct = DistinctPoints(points);
+      p = std::min<int>(p, distinct.size());
+    }
+    if (p < k_) {
+      std::stringstream ss;
+      ss << "The number of landmarks (" << p
+         << ") must be at least the number of clusters (" << k_ << ")";
+      throw std::runtime_error(ss.str());
+    }
+    if (landmarks_type_ == kKMeansLandmarks &&
+        p == static_cast<int>(distinct.size())) {
+      landmarks_.resize(points.rows(), p);
+      for (int j = 0; j < p; j++)
+        landmarks_.col(j) = points.col(distinct[j]);
+    } else if (landmarks_type_ == kKMeansLandmarks) {
+      KMeans<T> landmarks;
+      landmarks.SetNInit(1);
+      landmarks.SetMaxIter(10);
+      landmarks.Fit(input_data, p);
+      landmarks_ = landmarks.GetCenters();
+    } else {
+      // A partial Fisher-Yates shuffle
+      std::mt19937 rng(0);
+      std::vector<int> order(n);
+      for (int i = 0; i < n; i++)
+        order[i] = i;
+      landmarks_.resize(points.rows(), p);
+      for (int j = 0; j < p; j++) {
+        std::swap(order[j],
+                  order[std::uniform_int_distribution<int>(j, n - 1)(rng)]);
+        landmarks_.col(j) = points.col(order[j]);
+      }
+    }
+    points_.resize(0, 0);
+    tree_.Build(landmarks_);
+    int r = std::min(num_nearest_landmarks_, p);
+    std::vector<Eigen::Triplet<T>> triplets;
+    triplets.reserve(static_cast<size_t>(n) * r);
+    std::vector<typename KdTree<T>::Neighbor> neighbors;
+    for (int i = 0; i < n; i++) {
+      tree_.FindKNearest(points.col(i).data(), r, &neighbors);
+      AddLandmarkRow(i, neighbors, &triplets);
+    }
+    Eigen::SparseMatrix<T> z(n, p);
+    z.setFromTriplets(triplets.begin(), triplets.end());
+    std::vector<Eigen::Triplet<T>>().swap(triplets);
+    degrees_ = z.transpose() * Vector<T>::Ones(n);
+    landmark_scale_ = InvSqrtDegrees();
+    z = z * landmark_scale_.asDiagonal();
+    // The left singular vectors of z from the eigen decomposition of the
+    // p x p matrix z^T z
+    Matrix<T> gram = z.transpose() * z;
+    Eigen::SelfAdjointEigenSolver<Matrix<T>> eigen(gram);
+    Vector<T> singular = eigen.eigenvalues().tail(k_).reverse().cwiseMax(0)
+        .cwiseSqrt();
+    projection_ = eigen.eigenvectors().rightCols(k_).rowwise().reverse();
+    for (int j = 0; j < k_; j++)
+      projection_.col(j) *= singular(j) > 0 ? 1 / singular(j) : 0;
+    y_ = z * projection_;
+    eigenvalues_.resize(0);
+    eigen_residuals_.resize(0);
+  }
+
+  // The index of one point of every distinct column of points, in
+  // O(n log n d)
+  static std::vector<int> DistinctPoints(const Matrix<T> &points) {
+    std::vector<int> order(points.cols());
+    for (int i = 0; i < points.cols(); i++)
+      order[i] = i;
+    auto less = [&points](int a, int b) {
+      for (int j = 0; j < points.rows(); j++)
+        if (points(j, a) != points(j, b))
+          return points(j, a) < points(j, b);
+      return false;
+    };
+    std::sort(order.begin(), order.end(), less);
+    std::vector<int> distinct;
+    for (unsigned int i = 0; i < order.size(); i++)
+      if (i == 0 || less(order[i - 1], order[i]))
+        distinct.push_back(order[i]);
+    return distinct;
+  }
+
+  // Adds the similarities of point i to its nearest landmarks, normalized
+  // to sum to one; they are shifted by the closest distance first, which
+  // the normalization cancels, so that far points do not underflow
+  void AddLandmarkRow(int i,
+                      const std::vector<typename KdTree<T>::Neighbor> &nearest,
+                      std::vector<Eigen::Triplet<T>> *triplets) const {
+    T closest = std::sqrt(nearest[0].first);
+    T sum = 0;
+    for (unsigned int j = 0; j < nearest.size(); j++)
+      sum += exp(closest - std::sqrt(nearest[j].first));
+    for (unsigned int j = 0; j < nearest.size(); j++)
+      triplets->push_back(Eigen::Triplet<T>(
+          i, nearest[j].second,
+          exp(closest - std::sqrt(nearest[j].first)) / sum));
+  }
+
+  // Drops the landmarks of an earlier kLandmarkGraph fit
+  void ClearLandmarks() {
+    landmarks_.resize(0, 0);
+    landmark_scale_.resize(0);
+    projection_.resize(0, 0);
+  }
+
+  // Keeps the settings the embedding was computed with for Predict
+  void RecordFit(SpectralGraph graph) {
+    fitted_.graph = graph;
+    fitted_.eigen_solver = eigen_solver_;
+    fitted_.laplacian = laplacian_type_;
+    fitted_.sigma = sigma_;
+    fitted_.num_neighbors = num_neighbors_;
+    fitted_.epsilon = epsilon_;
+    fitted_.num_nearest_landmarks = num_nearest_landmarks_;
+    fitted_.hnsw = HnswGraph(graph);
+  }
+
+  // Whether the neighbours of graph are found with hnsw_
+  bool HnswGraph(SpectralGraph graph) const {
+    return hnsw_m_ > 0 && (graph == kKnnGraph || graph == kMutualKnnGraph);
+  }
+
+  // D^-1/2, with zero for isolated points
+  Vector<T> InvSqrtDegrees() const {
+    Vector<T> scale(degrees_.size());
+    for (int i = 0; i < scale.size(); i++)
+      scale(i) = degrees_(i) > 0 ? 1 / std::sqrt(degrees_(i)) : 0;
+    return scale;
+  }
+
+  // Stores in y_ k vectors truncated in the power iteration of D^-1 W,
+  // started from the degrees and from random positive vectors. The
+  // iteration stops when the acceleration |delta_t - delta_t-1| of every
+  // vector falls below power_tolerance_ / n.
+  template<typename MatrixType>
+  void PowerIteration(const MatrixType &similarity) {
+    int n = degrees_.size();
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<T> uniform(0, 1);
+    y_.resize(n, k_);
+    y_.col(0) = degrees_;
+    for (int j = 1; j < k_; j++)
+      for (int i = 0; i < n; i++)
+        y_(i, j) = uniform(rng);
+    Vector<T> inv_degrees = degrees_;
+    for (int i = 0; i < n; i++)
+      inv_degrees(i) = degrees_(i) > 0 ? 1 / degrees_(i) : 0;
+    for (int j = 0; j < k_; j++)
+      y_.col(j) /= y_.col(j).template lpNorm<1>();
+    Matrix<T> next(n, k_);
+    Vector<T> delta = Vector<T>::Zero(k_);
+    for (int iter = 0; iter < power_max_iter_; iter++) {
+      next.noalias() = similarity * y_;
+      next = inv_degrees.asDiagonal() * next;
+      T acceleration = 0;
+      for (int j = 0; j < k_; j++) {
+        next.col(j) /= next.col(j).template lpNorm<1>();
+        T change = (next.col(j) - y_.col(j)).cwiseAbs().maxCoeff();
+        acceleration = std::max(acceleration, std::abs(change - delta(j)));
+        delta(j) = change;
+      }
+      y_.swap(next);
+      if (iter > 0 && acceleration < power_tolerance_ / n)
+        break;
+    }
+    // The vectors are on the scale of 1 / n
+    y_ *= n;
+    eigenvalues_.resize(0);
+    eigen_residuals_.resize(0);
+  }
+
+  // Stores the sparse similarity graph in sparse_laplacian_
+  void SparseSimilarityGraph(const Matrix<T> &input_data) {
+    int n = input_data.rows();
+    points_ = input_data.transpose();
+    if (HnswGraph(graph_)) {
+      hnsw_ = HnswIndex<T>(hnsw_m_, hnsw_ef_construction_);
+      hnsw_.SetEf(hnsw_ef_);
+      hnsw_.SetNumThreads(num_threads_);
+      hnsw_.Build(points_);
+    } else {
+      tree_.Build(points_);
+    }
+    // Every thread finds the edges of a range of points
+    unsigned int num_threads = std::min<unsigned int>(
+        num_threads_, std::max(n / 1024, 1));
+    std::vector<std::vector<Eigen::Triplet<T>>> edges(num_threads);
+    std::vector<std::thread> threads;
+    int chunk = (n + num_threads - 1) / num_threads;
+    for (int t = 1; t < static_cast<int>(num_threads); t++)
+      threads.push_back(std::thread(
+          &SpectralClustering::FindEdges, this, std::min(n, t * chunk),
+          std::min(n, (t + 1) * chunk), &edges[t]));
+    FindEdges(0, std::min(n, chunk), &edges[0]);
+    for (unsigned int t = 0; t < threads.size(); t++)
+      threads[t].join();
+    for (unsigned int t = 1; t < num_threads; t++) {
+      edges[0].insert(edges[0].end(), edges[t].begin(), edges[t].end());
+      std::vector<Eigen::Triplet<T>>().swap(edges[t]);
+    }
+    // The edges from every point to its neighbours
+    Eigen::SparseMatrix<T> directed(n, n);
+    directed.setFromTriplets(edges[0].begin(), edges[0].end());
+    std::vector<Eigen::Triplet<T>>().swap(edges[0]);
+    if (graph_ == kEpsilonGraph) {
+      sparse_laplacian_ = directed;
+      return;
+    }
+    // Both directions have the same weight, so the mutual edges are the
+    // square roots of the products of the two directions
+    Eigen::SparseMatrix<T> reverse = directed.transpose();
+    Eigen::SparseMatrix<T> mutual =
+        directed.cwiseProduct(reverse).cwiseSqrt();
+    if (graph_ == kMutualKnnGraph)
+      sparse_laplacian_ = mutual;
+    else
+      sparse_laplacian_ = directed + reverse - mutual;
+    sparse_laplacian_.prune(T(0));
+  }
+
+  void FindEdges(int begin, int end,
+                 std::vector<Eigen::Triplet<T>> *edges) {
+    std::vector<typename KdTree<T>::Neighbor> neighbors;
+    for (int i = begin; i < end; i++) {
+      if (graph_ == kEpsilonGraph)
+        tree_.FindInRadius(points_.col(i).data(), epsilon_ * epsilon_,
+                           &neighbors);
+      else if (HnswGraph(graph_))
+        neighbors = hnsw_.Search(points_.col(i).data(), num_neighbors_ + 1);
+      else
+        tree_.FindKNearest(points_.col(i).data(), num_neighbors_ + 1,
+                           &neighbors);
+      for (unsigned int j = 0; j < neighbors.size(); j++) {
+        if (neighbors[j].second == i)
+          continue;
+        T sim = exp(0 - std::sqrt(neighbors[j].first)) / (2 * sigma_);
+        edges->push_back(Eigen::Triplet<T>(i, neighbors[j].second, sim));
+      }
+    }
+  }
+
+  // Stores the eigenvectors of the k smallest eigenvalues of the dense or
+  // sparse laplacian in y_
+  template<typename MatrixType>
+  void SmallestEigenvectors(const MatrixType &laplacian) {
+    if (eigen_solver_ == kLobpcgEigenSolver && 3 * k_ <= laplacian.rows()) {
+      lobpcg_.Compute(laplacian, k_);
+      y_ = lobpcg_.Eigenvectors();
+      eigenvalues_ = lobpcg_.Eigenvalues();
+      eigen_residuals_ = lobpcg_.Residuals();
+      return;
+    }
+    DenseEigenvectors(laplacian);
+    eigen_residuals_ = (laplacian * y_ - y_ * eigenvalues_.asDiagonal())
+        .colwise().norm().transpose();
+  }
+
+  // Sparse Laplacians are converted to a dense matrix, and the solver
+  // holds all n eigenvectors before the first k are kept
+  void DenseEigenvectors(const Matrix<T> &laplacian) {
+    // The eigenvalues are sorted in increasing order
+    Eigen::SelfAdjointEigenSolver<Matrix<T>> eigen(laplacian);
+    y_ = eigen.eigenvectors().leftCols(k_);
+    eigenvalues_ = eigen.eigenvalues().head(k_);
+  }
+
   int k_;
   T sigma_;
+  SpectralEigenSolver eigen_solver_;
+  SpectralLaplacian laplacian_type_;
+  T power_tolerance_;
+  int power_max_iter_;
+  SpectralGraph graph_;
+  int num_neighbors_;
+  T epsilon_;
+  int num_landmarks_;
+  int num_nearest_landmarks_;
+  SpectralLandmarks landmarks_type_;
+  unsigned int num_threads_;
+  int coarse_size_;
+  int refine_iterations_;
+  int hnsw_m_;
+  int hnsw_ef_construction_;
+  int hnsw_ef_;
+  // Whether the graph is in laplacian_ rather than sparse_laplacian_
+  bool dense_graph_;
   KMeans<T> kmeans_;
-  SvdSolver<T> svd_;
-  Matrix<T> similarity_;
-  Matrix<T> degrees_;
+  LobpcgSolver<T> lobpcg_;
+  // The settings of the last fit, which Predict follows rather than the
+  // setters called since
+  struct FittedSettings {
+    SpectralGraph graph;
+    SpectralEigenSolver eigen_solver;
+    SpectralLaplacian laplacian;
+    T sigma;
+    int num_neighbors;
+    T epsilon;
+    int num_nearest_landmarks;
+    // Whether the neighbours are found with hnsw_
+    bool hnsw;
+  };
+  FittedSettings fitted_;
+  // The similarity graph, then the Laplacian
   Matrix<T> laplacian_;
-  Matrix<T> u_;
-  Vector<T> y_;
+  Eigen::SparseMatrix<T> sparse_laplacian_;
+  // The degree of every point, or of every landmark with kLandmarkGraph
+  Vector<T> degrees_;
+  // The landmarks of kLandmarkGraph, one per column, the inverse square
+  // roots of their degrees, and the map from landmark similarities to
+  // the embedding
+  Matrix<T> landmarks_;
+  // The training points, one per column, and a kd-tree over them or
+  // over the landmarks, or an HNSW index over them
+  Matrix<T> points_;
+  KdTree<T> tree_;
+  HnswIndex<T> hnsw_;
+  Vector<T> landmark_scale_;
+  Matrix<T> projection_;
+  // The embedding of the points, one per row, before any row
+  // normalization
+  Matrix<T> y_;
+  Vector<T> eigenvalues_;
+  Vector<T> eigen_residuals_;
   Matrix<T> labels_;
 };
 }  // namespace Nice
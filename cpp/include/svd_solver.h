@@ -23,23 +23,98 @@
 #ifndef CPP_INCLUDE_SVD_SOLVER_H_
 #define CPP_INCLUDE_SVD_SOLVER_H_
 
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <stdexcept>
 #include "include/matrix.h"
 #include "include/vector.h"
 #include "Eigen/SVD"
+#include "Eigen/QR"
 
 
 namespace Nice {
 
+// The SVD algorithm of SvdSolver
+enum SvdAlgorithm {
+  // One-sided Jacobi, accurate but slow on large matrices
+  kJacobiSvd = 0,
+  // Divide and conquer, much faster on large matrices. Needs Eigen 3.3,
+  // SvdSolver::SetAlgorithm rejects it with older versions.
+  kBdcSvd,
+  // The randomized range finder of Halko, Martinsson and Tropp (2011),
+  // for the leading singular triplets only
+  kRandomizedSvd
+};
+
 // Abstract class of svd solver
 template<typename T>
 class SvdSolver {
  private:
-  Eigen::JacobiSVD<Matrix<T>> svd_;
+  SvdAlgorithm algorithm_;
+  bool thin_;
+  bool compute_u_;
+  bool compute_v_;
+  int rank_;
+  int oversampling_;
+  int power_iterations_;
+  unsigned int seed_;
+  Matrix<T> u_;
+  Matrix<T> v_;
+  Vector<T> s_;
 
  public:
   SvdSolver()
   :
-  svd_() {}
+  algorithm_(kJacobiSvd), thin_(false), compute_u_(true), compute_v_(true),
+  rank_(0), oversampling_(10), power_iterations_(2), seed_(0) {}
+
+  /// Selects the SVD algorithm, Jacobi by default. kBdcSvd throws
+  /// std::runtime_error before Eigen 3.3, and kRandomizedSvd needs a rank
+  /// from SetRandomized before Compute.
+  void SetAlgorithm(SvdAlgorithm algorithm) {
+#if !EIGEN_VERSION_AT_LEAST(3, 3, 0)
+    if (algorithm == kBdcSvd)
+      throw std::runtime_error("kBdcSvd needs Eigen 3.3 or later");
+#endif
+    algorithm_ = algorithm;
+  }
+
+  /// Computes the thin factors (m x min(m, n) and n x min(m, n)) instead
+  /// of the full square ones
+  void SetThin(bool thin) {
+    thin_ = thin;
+  }
+
+  /// Selects the factors to compute, both by default; the others are left
+  /// empty
+  void SetFactors(bool compute_u, bool compute_v) {
+    compute_u_ = compute_u;
+    compute_v_ = compute_v;
+  }
+
+  /// Selects the randomized SVD of the rank leading singular triplets,
+  /// sampling rank + oversampling directions refined by power_iterations
+  /// power iterations
+  void SetRandomized(int rank, int oversampling = 10,
+                     int power_iterations = 2) {
+    if (rank < 1) {
+      std::stringstream ss;
+      ss << "The rank of the randomized SVD (" << rank
+         << ") must be at least 1";
+      throw std::runtime_error(ss.str());
+    }
+    algorithm_ = kRandomizedSvd;
+    rank_ = rank;
+    oversampling_ = oversampling;
+    power_iterations_ = power_iterations;
+  }
+
+  /// The seed of the random sampling of kRandomizedSvd
+  void SetSeed(unsigned int seed) {
+    seed_ = seed;
+  }
 
   /// Computation function that perform the actual SVD decomposition
   ///
@@ -49,7 +124,13 @@ class SvdSolver {
   /// \return
   /// Void
   void Compute(const Matrix<T> &a) {
-    svd_.compute(a, Eigen::ComputeFullU|Eigen::ComputeFullV);
+    if (algorithm_ == kRandomizedSvd && rank_ < 1)
+      throw std::runtime_error(
+          "kRandomizedSvd needs a rank, see SetRandomized");
+    if (algorithm_ == kRandomizedSvd)
+      ComputeRandomized(a);
+    else
+      ComputeExact(a, Options());
   }
 
   /// Return the matrix U after SVD decomposition
@@ -58,9 +139,9 @@ class SvdSolver {
   /// Void
   ///
   /// \return
-  /// Matrix U
+  /// Matrix U, full, thin or with the requested rank columns as computed
   Matrix<T> MatrixU() const {
-    return svd_.matrixU();
+    return u_;
   }
 
   /// Return the matrix V after SVD decomposition
@@ -69,9 +150,9 @@ class SvdSolver {
   /// Void
   ///
   /// \return
-  /// Matrix V
+  /// Matrix V, full, thin or with the requested rank columns as computed
   Matrix<T> MatrixV() const {
-    return svd_.matrixV();
+    return v_;
   }
 
   /// Return the singular values  after SVD decomposition
@@ -82,7 +163,7 @@ class SvdSolver {
   /// \return
   /// Vector S
   Vector<T> SingularValues() const {
-    return svd_.singularValues();
+    return s_;
   }
 
   /// Return the rank of a matrix through SVD decomposition
@@ -91,14 +172,106 @@ class SvdSolver {
   /// An arbitrary matrix
   ///
   /// \return
-  /// Matrix rank
-  int Rank(const Matrix<T> &a) {
-    Compute(a);
-    return svd_.rank();
+  /// Matrix rank. The factors of the last Compute are left untouched.
+  int Rank(const Matrix<T> &a) const {
+    // Only the singular values are needed
+    Vector<T> s;
+#if EIGEN_VERSION_AT_LEAST(3, 3, 0)
+    if (algorithm_ == kBdcSvd)
+      s = Eigen::BDCSVD<Matrix<T>>(a).singularValues();
+#endif
+    if (s.size() == 0)
+      s = Eigen::JacobiSVD<Matrix<T>>(a).singularValues();
+    if (s.size() == 0)
+      return 0;
+    // The threshold of Eigen's JacobiSVD::rank
+    T threshold = std::max<T>(
+        s(0) * std::min(a.rows(), a.cols()) *
+        std::numeric_limits<T>::epsilon(),
+        std::numeric_limits<T>::min());
+    int rank = 0;
+    while (rank < s.size() && s(rank) > threshold)
+      rank++;
+    return rank;
+  }
+
+ private:
+  unsigned int Options() const {
+    unsigned int options = 0;
+    if (compute_u_)
+      options |= thin_ ? Eigen::ComputeThinU : Eigen::ComputeFullU;
+    if (compute_v_)
+      options |= thin_ ? Eigen::ComputeThinV : Eigen::ComputeFullV;
+    return options;
+  }
+
+  void ComputeExact(const Matrix<T> &a, unsigned int options) {
+#if EIGEN_VERSION_AT_LEAST(3, 3, 0)
+    if (algorithm_ == kBdcSvd) {
+      Eigen::BDCSVD<Matrix<T>> svd(a, options);
+      Store(svd, options);
+      return;
+    }
+#endif
+    Eigen::JacobiSVD<Matrix<T>> svd(a, options);
+    Store(svd, options);
+  }
+
+  template<typename Decomposition>
+  void Store(const Decomposition &svd, unsigned int options) {
+    s_ = svd.singularValues();
+    if (options & (Eigen::ComputeFullU | Eigen::ComputeThinU))
+      u_ = svd.matrixU();
+    else
+      u_.resize(0, 0);
+    if (options & (Eigen::ComputeFullV | Eigen::ComputeThinV))
+      v_ = svd.matrixV();
+    else
+      v_.resize(0, 0);
+  }
+
+  // The rank_ leading singular triplets: an orthonormal basis q of the
+  // range of a is sampled with a Gaussian test matrix and refined by
+  // power iterations, then the small matrix q^T a is decomposed exactly
+  void ComputeRandomized(const Matrix<T> &a) {
+    int rank = std::min<int>(rank_, std::min(a.rows(), a.cols()));
+    int samples = std::min<int>(rank + oversampling_,
+                                std::min(a.rows(), a.cols()));
+    std::mt19937 rng(seed_);
+    std::normal_distribution<T> normal;
+    Matrix<T> omega(a.cols(), samples);
+    for (int j = 0; j < samples; j++)
+      for (int i = 0; i < a.cols(); i++)
+        omega(i, j) = normal(rng);
+    Matrix<T> q = Orthonormalize(a * omega);
+    for (int i = 0; i < power_iterations_; i++) {
+      Matrix<T> z = Orthonormalize(a.transpose() * q);
+      q = Orthonormalize(a * z);
+    }
+    Matrix<T> b = q.transpose() * a;
+    unsigned int options = 0;
+    if (compute_u_)
+      options |= Eigen::ComputeThinU;
+    if (compute_v_)
+      options |= Eigen::ComputeThinV;
+    Eigen::JacobiSVD<Matrix<T>> svd(b, options);
+    s_ = svd.singularValues().head(rank);
+    if (compute_u_)
+      u_ = q * svd.matrixU().leftCols(rank);
+    else
+      u_.resize(0, 0);
+    if (compute_v_)
+      v_ = svd.matrixV().leftCols(rank);
+    else
+      v_.resize(0, 0);
+  }
+
+  static Matrix<T> Orthonormalize(const Matrix<T> &x) {
+    Eigen::HouseholderQR<Matrix<T>> qr(x);
+    return qr.householderQ() * Matrix<T>::Identity(x.rows(), x.cols());
   }
 };
 
 }  // namespace Nice
 
 #endif  // CPP_INCLUDE_SVD_SOLVER_H_
-
@@ -50,10 +50,8 @@ class CPUOperationsInterface {
     MatrixMap <T> kernel_matrix(reinterpret_cast<T *>
                                 (kernel_matrix_buf.buf), row, row);
     if (kernel_type == "Gaussian") {
-      kernel_matrix =
-          CpuOperations<T>::GenKernelMatrix(input,
-                                         kGaussianKernel,
-                                         constant);
+      CpuOperations<T>::GenKernelMatrix(input, kGaussianKernel, constant,
+                                        &kernel_matrix);
       PyBuffer_Release(&input_buf);
       PyBuffer_Release(&kernel_matrix_buf);
     } else {
@@ -71,7 +69,7 @@ class CPUOperationsInterface {
     MatrixMap <T> a(reinterpret_cast<T *>(a_buf.buf), row_a, col_a);
     MatrixMap <T> b(reinterpret_cast<T *>(b_buf.buf), row_b, col_b);
     MatrixMap <T> c(reinterpret_cast<T *>(c_buf.buf), row_a, col_b);
-    c = CpuOperations<T>::Multiply(a, b);
+    CpuOperations<T>::Multiply(a, b, &c);
     PyBuffer_Release(&a_buf);
     PyBuffer_Release(&b_buf);
     PyBuffer_Release(&c_buf);
@@ -85,7 +83,7 @@ class CPUOperationsInterface {
     PyObject_GetBuffer(b_obj, &b_buf, PyBUF_SIMPLE);
     MatrixMap <T> a(reinterpret_cast<T *>(a_buf.buf), row_a, col_a);
     MatrixMap <T> b(reinterpret_cast<T *>(b_buf.buf), row_a, col_a);
-    b = CpuOperations<T>::Multiply(a, scalar);
+    CpuOperations<T>::Multiply(a, scalar, &b);
     PyBuffer_Release(&a_buf);
     PyBuffer_Release(&b_buf);
   }
@@ -96,7 +94,7 @@ class CPUOperationsInterface {
     PyObject_GetBuffer(b_obj, &b_buf, PyBUF_SIMPLE);
     MatrixMap <T> a(reinterpret_cast<T *>(a_buf.buf), row_a, col_a);
     MatrixMap <T> b(reinterpret_cast<T *>(b_buf.buf), row_a, col_a);
-    b = CpuOperations<T>::Inverse(a);
+    CpuOperations<T>::Inverse(a, &b);
     PyBuffer_Release(&a_buf);
     PyBuffer_Release(&b_buf);
   }
@@ -114,7 +112,7 @@ class CPUOperationsInterface {
       row_v = row_m;
     }
     MatrixMap <T> v(reinterpret_cast<T *>(v_buf.buf), row_v, 1);
-    v = CpuOperations<T>::Norm(m, p, axis);
+    CpuOperations<T>::Norm(m, p, axis, &v);
     PyBuffer_Release(&m_buf);
     PyBuffer_Release(&v_buf);
   }
@@ -126,7 +124,7 @@ class CPUOperationsInterface {
     PyObject_GetBuffer(c_obj, &c_buf, PyBUF_SIMPLE);
     MatrixMap <T> m(reinterpret_cast<T *>(m_buf.buf), row_m, col_m);
     MatrixMap <T> c(reinterpret_cast<T *>(c_buf.buf), row_m, col_m);
-    c = CpuOperations<T>::Center(m, axis);
+    CpuOperations<T>::Center(m, axis, &c);
     PyBuffer_Release(&m_buf);
     PyBuffer_Release(&c_buf);
   }
@@ -138,7 +136,7 @@ class CPUOperationsInterface {
     PyObject_GetBuffer(n_obj, &n_buf, PyBUF_SIMPLE);
     MatrixMap <T> m(reinterpret_cast<T *>(m_buf.buf), row_m, col_m);
     MatrixMap <T> n(reinterpret_cast<T *>(n_buf.buf), row_m, col_m);
-    n = CpuOperations<T>::Normalize(m, p, axis);
+    CpuOperations<T>::Normalize(m, p, axis, &n);
     PyBuffer_Release(&m_buf);
     PyBuffer_Release(&n_buf);
   }
@@ -156,7 +154,7 @@ class CPUOperationsInterface {
       row_s = row_m;
     }
     MatrixMap <T> s(reinterpret_cast<T *>(s_buf.buf), row_s, 1);
-    s = CpuOperations<T>::StandardDeviation(m, axis);
+    CpuOperations<T>::StandardDeviation(m, axis, &s);
     PyBuffer_Release(&m_buf);
     PyBuffer_Release(&s_buf);
   }
@@ -68,6 +68,11 @@
 //                                         PyObject *, int row_2, int col_2)
 // = &Nice::KDACCPUInterface<double>::Fit;
 
+// Compile every member of the operations interface, not only those
+// exposed to Python below
+template class Nice::CPUOperationsInterface<float>;
+template class Nice::CPUOperationsInterface<double>;
+
 void (Nice::KDACInterface<float>::*Fit0Arg)()
 = &Nice::KDACInterface<float>::Fit;
 void (Nice::KDACInterface<float>::*Fit1Arg)(PyObject *, int, int)
@@ -0,0 +1,66 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Northeastern University
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Blob data sets shared by the clustering tests
+
+#ifndef CPP_TEST_BLOB_TEST_UTIL_H_
+#define CPP_TEST_BLOB_TEST_UTIL_H_
+
+#include <stdlib.h>
+#include <vector>
+#include "gtest/gtest.h"
+#include "include/matrix.h"
+
+namespace Nice {
+namespace test {
+
+// Generates k well separated blobs of points_per_blob points in d
+// dimensions, the points of blob c are stored in consecutive rows
+template<typename T>
+Matrix<T> GenerateBlobs(int k, int points_per_blob, int d) {
+  srand(0);
+  Matrix<T> data = Matrix<T>::Random(k * points_per_blob, d);
+  for (int c = 0; c < k; c++)
+    data.block(c * points_per_blob, 0, points_per_blob, d).array() +=
+        static_cast<T>(20 * c);
+  return data;
+}
+
+// Checks that every blob of GenerateBlobs received a single label and
+// that different blobs received different labels
+template<typename Labels>
+void ExpectBlobsRecovered(const Labels &labels, int k, int points_per_blob) {
+  std::vector<int> blob_labels;
+  for (int c = 0; c < k; c++) {
+    int label = static_cast<int>(labels(c * points_per_blob));
+    for (int i = 0; i < points_per_blob; i++)
+      EXPECT_EQ(label, static_cast<int>(labels(c * points_per_blob + i)));
+    for (unsigned int b = 0; b < blob_labels.size(); b++)
+      EXPECT_NE(blob_labels[b], label);
+    blob_labels.push_back(label);
+  }
+}
+
+}  // namespace test
+}  // namespace Nice
+
+#endif  // CPP_TEST_BLOB_TEST_UTIL_H_
@@ -77,3 +77,12 @@ TYPED_TEST(MatrixCenterTest, BadAxis) {
              7, 8, 9;
   ASSERT_DEATH(this->MatrixCenter(2), ".*");
 }
+
+TYPED_TEST(MatrixCenterTest, InPlace) {
+  srand(0);
+  this->a = Nice::Matrix<TypeParam>::Random(50, 4);
+  this->correct_ans = this->a.rowwise() - this->a.colwise().mean();
+  Nice::CpuOperations<TypeParam>::Center(&this->a);
+  ASSERT_TRUE(this->correct_ans.isApprox(this->a, this->precision));
+  ASSERT_NEAR(0, this->a.colwise().sum().cwiseAbs().maxCoeff(), 1e-4);
+}
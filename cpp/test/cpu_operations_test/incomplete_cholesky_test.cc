@@ -0,0 +1,102 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Northeastern University
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <vector>
+#include "Eigen/Dense"
+#include "gtest/gtest.h"
+#include "include/cpu_operations.h"
+#include "include/matrix.h"
+#include "include/kernel_types.h"
+
+template<class T>
+class IncompleteCholeskyTest : public ::testing::Test {
+ public:
+  Nice::Matrix<T> data_matrix_;
+  Nice::Matrix<T> kernel_matrix_;
+
+  // Three tight blobs, whose Gaussian kernel matrix is close to rank 3
+  void SetupBlobs(int n) {
+    srand(0);
+    data_matrix_ = 0.0001 * Nice::Matrix<T>::Random(n, 3);
+    for (int i = 0; i < n; i++)
+      data_matrix_(i, i % 3) += 10;
+    kernel_matrix_ = Nice::CpuOperations<T>::GenKernelMatrix(data_matrix_,
+        Nice::kGaussianKernel, 1.0);
+  }
+};
+
+typedef ::testing::Types<float, double> FloatTypes;
+TYPED_TEST_CASE(IncompleteCholeskyTest, FloatTypes);
+
+TYPED_TEST(IncompleteCholeskyTest, LowRank) {
+  this->SetupBlobs(60);
+  Nice::Matrix<TypeParam> g =
+      Nice::CpuOperations<TypeParam>::IncompleteCholesky(this->data_matrix_,
+          Nice::kGaussianKernel, 1.0, 1e-3);
+  EXPECT_EQ(60, g.rows());
+  EXPECT_LE(g.cols(), 10);
+  Nice::Matrix<TypeParam> residual = this->kernel_matrix_ - g * g.transpose();
+  EXPECT_LE(residual.trace(), 1e-3 * this->kernel_matrix_.trace());
+  EXPECT_LE(residual.cwiseAbs().maxCoeff(), 0.1);
+}
+
+TYPED_TEST(IncompleteCholeskyTest, FullRankIsExact) {
+  // A positive definite matrix is recovered exactly at full rank
+  int n = 8;
+  srand(0);
+  Nice::Matrix<TypeParam> a = Nice::Matrix<TypeParam>::Random(n, n);
+  Nice::Matrix<TypeParam> k = a * a.transpose() +
+      Nice::Matrix<TypeParam>::Identity(n, n);
+  std::vector<int> pivots;
+  Nice::Matrix<TypeParam> g =
+      Nice::CpuOperations<TypeParam>::IncompleteCholeskyFromKernel(
+          [&k](int i, int j) { return k(i, j); }, n, 0, 0, &pivots);
+  EXPECT_EQ(n, g.cols());
+  EXPECT_EQ(n, static_cast<int>(pivots.size()));
+  EXPECT_TRUE((g * g.transpose()).isApprox(k, 1e-3));
+  // The first pivot is the largest diagonal entry
+  int largest;
+  k.diagonal().maxCoeff(&largest);
+  EXPECT_EQ(largest, pivots[0]);
+}
+
+TYPED_TEST(IncompleteCholeskyTest, MaxRank) {
+  this->SetupBlobs(30);
+  Nice::Matrix<TypeParam> g =
+      Nice::CpuOperations<TypeParam>::IncompleteCholesky(this->data_matrix_,
+          Nice::kGaussianKernel, 1.0, 0, 2);
+  EXPECT_EQ(2, g.cols());
+}
+
+TYPED_TEST(IncompleteCholeskyTest, EvaluatesOnlyPivotColumns) {
+  this->SetupBlobs(40);
+  int evaluations = 0;
+  const Nice::Matrix<TypeParam> &k = this->kernel_matrix_;
+  Nice::Matrix<TypeParam> g =
+      Nice::CpuOperations<TypeParam>::IncompleteCholeskyFromKernel(
+          [&k, &evaluations](int i, int j) {
+            evaluations++;
+            return k(i, j);
+          }, 40, 1e-3);
+  // The diagonal and one column per rank
+  EXPECT_EQ(40 + 40 * g.cols(), evaluations);
+}
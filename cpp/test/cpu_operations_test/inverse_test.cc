@@ -72,6 +72,15 @@ TYPED_TEST(InverseTest, SingularMatrix) {
   ASSERT_DEATH(this->GetInverse(), ".*");
 }
 
+TYPED_TEST(InverseTest, NumericallySingularMatrix) {
+  // No pivot is exactly zero after rounding
+  this->input.resize(3, 3);
+  this->input << 1, 2, 3,
+                 4, 5, 6,
+                 7, 8, 9;
+  ASSERT_DEATH(this->GetInverse(), ".*");
+}
+
 TYPED_TEST(InverseTest, NonSquareMatrix) {
   this->input.setRandom(2, 3);
   ASSERT_DEATH(this->GetInverse(), ".*");
@@ -80,3 +89,22 @@ TYPED_TEST(InverseTest, NonSquareMatrix) {
 TYPED_TEST(InverseTest, EmptyMatrix) {
   ASSERT_DEATH(this->GetInverse(), ".*");
 }
+
+TYPED_TEST(InverseTest, SymmetricIndefiniteMatrix) {
+  // Well conditioned, but with tiny diagonal pivots
+  this->input.resize(2, 2);
+  this->input << 1e-10, 1,
+                 1, 1e-10;
+  this->GetInverse();
+  EXPECT_TRUE((this->input * this->output).isApprox(
+      Nice::Matrix<TypeParam>::Identity(2, 2), 1e-4));
+}
+
+TYPED_TEST(InverseTest, BadlyScaledDiagonalMatrix) {
+  this->input.setZero(2, 2);
+  this->input(0, 0) = 1e-20;
+  this->input(1, 1) = 1e20;
+  this->GetInverse();
+  EXPECT_NEAR(1, this->output(0, 0) * 1e-20, 1e-4);
+  EXPECT_NEAR(1, this->output(1, 1) * 1e20, 1e-4);
+}
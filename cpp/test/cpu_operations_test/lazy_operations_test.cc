@@ -0,0 +1,97 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Northeastern University
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <type_traits>
+#include "Eigen/Dense"
+#include "gtest/gtest.h"
+#include "include/cpu_operations.h"
+#include "include/matrix.h"
+
+template<class T>
+class LazyOperationsTest : public ::testing::Test {
+ public:
+  typedef Nice::CpuOperations<T> Eager;
+  typedef typename Nice::CpuOperations<T>::Lazy Lazy;
+  Nice::Matrix<T> a_;
+  Nice::Matrix<T> b_;
+  Nice::Matrix<T> c_;
+
+  void Setup(int n) {
+    srand(0);
+    a_ = Nice::Matrix<T>::Random(n, n);
+    b_ = Nice::Matrix<T>::Random(n, n);
+    c_ = Nice::Matrix<T>::Random(n, n);
+  }
+};
+
+typedef ::testing::Types<float, double> FloatTypes;
+TYPED_TEST_CASE(LazyOperationsTest, FloatTypes);
+
+TYPED_TEST(LazyOperationsTest, MatchesEager) {
+  typedef typename TestFixture::Eager Eager;
+  typedef typename TestFixture::Lazy Lazy;
+  this->Setup(20);
+  TypeParam s = 3;
+  Nice::Matrix<TypeParam> eager = Eager::Add(Eager::Multiply(
+      Eager::Subtract(this->a_, this->b_), s), this->c_);
+  Nice::Matrix<TypeParam> lazy = Lazy::Add(Lazy::Multiply(
+      Lazy::Subtract(this->a_, this->b_), s), this->c_);
+  EXPECT_TRUE(eager.isApprox(lazy));
+
+  eager = Eager::Subtract(Eager::Add(Eager::Transpose(this->a_), s), s);
+  lazy = Lazy::Subtract(Lazy::Add(Lazy::Transpose(this->a_), s), s);
+  EXPECT_TRUE(eager.isApprox(lazy));
+
+  eager = Eager::Multiply(Eager::Add(this->a_, this->b_), this->c_);
+  lazy = Lazy::Multiply(Lazy::Add(this->a_, this->b_), this->c_);
+  EXPECT_TRUE(eager.isApprox(lazy));
+}
+
+TYPED_TEST(LazyOperationsTest, SizeMismatch) {
+  typedef typename TestFixture::Lazy Lazy;
+  this->a_.setRandom(2, 3);
+  this->b_.setRandom(3, 2);
+  ASSERT_DEATH(Lazy::Add(this->a_, this->b_), ".*");
+  ASSERT_DEATH(Lazy::Multiply(this->a_, this->a_), ".*");
+}
+
+TYPED_TEST(LazyOperationsTest, NoTemporaries) {
+  // The eager API evaluates every step of (a - b) * s + c into an n x n
+  // temporary. The lazy one builds a single expression, which is not a
+  // matrix, reads a, b and c only when it is assigned, and is evaluated
+  // straight into the result.
+  typedef typename TestFixture::Lazy Lazy;
+  this->Setup(50);
+  TypeParam s = 3;
+  auto expression = Lazy::Add(Lazy::Multiply(
+      Lazy::Subtract(this->a_, this->b_), s), this->c_);
+  EXPECT_FALSE((std::is_base_of<
+      Eigen::PlainObjectBase<Nice::Matrix<TypeParam>>,
+      decltype(expression)>::value));
+  this->a_.setZero();
+  Nice::Matrix<TypeParam> result(50, 50);
+  const TypeParam *storage = result.data();
+  result.noalias() = expression;
+  EXPECT_EQ(storage, result.data());
+  Nice::Matrix<TypeParam> expected = -this->b_ * s + this->c_;
+  EXPECT_TRUE(result.isApprox(expected));
+}
@@ -0,0 +1,125 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Northeastern University
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <vector>
+#include "Eigen/Dense"
+#include "gtest/gtest.h"
+#include "include/cpu_operations.h"
+#include "include/matrix.h"
+#include "include/vector.h"
+
+// Buffers owned by the caller, laid out like NumPy arrays
+template<typename T>
+using RowMajorMap = Eigen::Map<Eigen::Matrix<T, Eigen::Dynamic,
+                                             Eigen::Dynamic, Eigen::RowMajor>>;
+
+template<class T>
+class OutputParameterTest : public ::testing::Test {
+ public:
+  typedef Nice::CpuOperations<T> Ops;
+  Nice::Matrix<T> a_;
+  Nice::Matrix<T> b_;
+  std::vector<T> buffer_;
+
+  void Setup(int n) {
+    srand(0);
+    a_ = Nice::Matrix<T>::Random(n, n);
+    b_ = Nice::Matrix<T>::Random(n, n);
+    a_ += n * Nice::Matrix<T>::Identity(n, n);
+    buffer_.assign(n * n, 0);
+  }
+
+  RowMajorMap<T> Output(int rows, int cols) {
+    return RowMajorMap<T>(buffer_.data(), rows, cols);
+  }
+};
+
+typedef ::testing::Types<float, double> FloatTypes;
+TYPED_TEST_CASE(OutputParameterTest, FloatTypes);
+
+TYPED_TEST(OutputParameterTest, Arithmetic) {
+  typedef typename TestFixture::Ops Ops;
+  this->Setup(6);
+  RowMajorMap<TypeParam> out = this->Output(6, 6);
+  Ops::Add(this->a_, this->b_, &out);
+  EXPECT_TRUE(out.isApprox(Ops::Add(this->a_, this->b_)));
+  Ops::Subtract(this->a_, TypeParam(2), &out);
+  EXPECT_TRUE(out.isApprox(Ops::Subtract(this->a_, TypeParam(2))));
+  Ops::Multiply(this->a_, this->b_, &out);
+  EXPECT_TRUE(out.isApprox(Ops::Multiply(this->a_, this->b_)));
+  Ops::Transpose(this->a_, &out);
+  EXPECT_TRUE(out.isApprox(Ops::Transpose(this->a_)));
+  Ops::Inverse(this->a_, &out);
+  EXPECT_TRUE(out.isApprox(Ops::Inverse(this->a_)));
+  Ops::Center(this->a_, 1, &out);
+  EXPECT_TRUE(out.isApprox(Ops::Center(this->a_, 1)));
+  Ops::Normalize(this->a_, 2, 0, &out);
+  EXPECT_TRUE(out.isApprox(Ops::Normalize(this->a_, 2, 0)));
+}
+
+TYPED_TEST(OutputParameterTest, Vectors) {
+  typedef typename TestFixture::Ops Ops;
+  this->Setup(5);
+  RowMajorMap<TypeParam> out = this->Output(5, 1);
+  Ops::Norm(this->a_, 1, 1, &out);
+  EXPECT_TRUE(out.isApprox(Ops::Norm(this->a_, 1, 1)));
+  Ops::StandardDeviation(this->a_, 0, &out);
+  EXPECT_TRUE(out.isApprox(Ops::StandardDeviation(this->a_, 0)));
+  Nice::Vector<TypeParam> u = this->a_.col(0);
+  Nice::Vector<TypeParam> v = this->b_.col(0);
+  RowMajorMap<TypeParam> outer = this->Output(5, 5);
+  Ops::OuterProduct(u, v, &outer);
+  EXPECT_TRUE(outer.isApprox(Ops::OuterProduct(u, v)));
+}
+
+TYPED_TEST(OutputParameterTest, InPlace) {
+  typedef typename TestFixture::Ops Ops;
+  this->Setup(4);
+  Nice::Matrix<TypeParam> expected = Ops::Add(this->a_, this->b_);
+  Ops::Add(this->a_, this->b_, &this->a_);
+  EXPECT_TRUE(this->a_.isApprox(expected));
+  expected = Ops::Multiply(this->a_, TypeParam(3));
+  Ops::Multiply(this->a_, TypeParam(3), &this->a_);
+  EXPECT_TRUE(this->a_.isApprox(expected));
+  expected = Ops::Transpose(this->a_);
+  Ops::Transpose(&this->a_);
+  EXPECT_TRUE(this->a_.isApprox(expected));
+  // A caller owned buffer is centered where it is
+  RowMajorMap<TypeParam> out = this->Output(4, 4);
+  out = this->b_;
+  Ops::Center(&out);
+  EXPECT_TRUE(out.isApprox(Ops::Center(this->b_)));
+}
+
+TYPED_TEST(OutputParameterTest, Logical) {
+  typedef typename TestFixture::Ops Ops;
+  Nice::Matrix<bool> a(2, 2), b(2, 2), out;
+  a << true, false, true, false;
+  b << true, true, false, false;
+  Ops::LogicalAnd(a, b, &out);
+  EXPECT_EQ(Ops::LogicalAnd(a, b), out);
+  Ops::LogicalOr(a, b, &out);
+  EXPECT_EQ(Ops::LogicalOr(a, b), out);
+  Nice::Matrix<bool> expected = Ops::LogicalNot(a);
+  Ops::LogicalNot(a, &a);
+  EXPECT_EQ(expected, a);
+}
@@ -0,0 +1,141 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Northeastern University
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <cmath>
+#include "Eigen/Dense"
+#include "gtest/gtest.h"
+#include "include/cpu_operations.h"
+#include "include/matrix.h"
+#include "include/vector.h"
+
+template<class T>
+class SolverTest : public ::testing::Test {
+ public:
+  typedef typename Nice::CpuOperations<T>::Solver Solver;
+  Nice::Matrix<T> a_;
+  Nice::Matrix<T> b_;
+
+  void SetupSystem(int n, bool symmetric) {
+    srand(0);
+    a_ = Nice::Matrix<T>::Random(n, n);
+    if (symmetric)
+      a_ = a_ * a_.transpose();
+    a_ += n * Nice::Matrix<T>::Identity(n, n);
+    b_ = Nice::Matrix<T>::Random(n, 3);
+  }
+};
+
+typedef ::testing::Types<float, double> MyTypes;
+TYPED_TEST_CASE(SolverTest, MyTypes);
+
+TYPED_TEST(SolverTest, SymmetricUsesCholesky) {
+  this->SetupSystem(20, true);
+  typename TestFixture::Solver solver(this->a_);
+  EXPECT_EQ(Nice::kCholeskyFactorization, solver.GetFactorization());
+  Nice::Matrix<TypeParam> x = solver.Solve(this->b_);
+  EXPECT_TRUE((this->a_ * x).isApprox(this->b_, 1e-3));
+  EXPECT_NEAR(std::log(this->a_.determinant()), solver.LogDeterminant(),
+              1e-3);
+}
+
+TYPED_TEST(SolverTest, SymmetricIndefiniteUsesLu) {
+  this->a_.resize(2, 2);
+  this->a_ << 1e-10, 1,
+              1, 1e-10;
+  typename TestFixture::Solver solver(this->a_);
+  EXPECT_EQ(Nice::kLuFactorization, solver.GetFactorization());
+  EXPECT_TRUE(solver.IsInvertible());
+  EXPECT_GT(solver.ConditionEstimate(), 0.5);
+  Nice::Vector<TypeParam> b(2);
+  b << 1, 2;
+  Nice::Matrix<TypeParam> x = solver.Solve(b);
+  EXPECT_TRUE((this->a_ * x).isApprox(b, 1e-4));
+}
+
+TYPED_TEST(SolverTest, GeneralUsesLu) {
+  this->SetupSystem(20, false);
+  typename TestFixture::Solver solver(this->a_);
+  EXPECT_EQ(Nice::kLuFactorization, solver.GetFactorization());
+  // The factorization is reused for every right hand side
+  for (int j = 0; j < this->b_.cols(); j++) {
+    Nice::Matrix<TypeParam> x = solver.Solve(this->b_.col(j));
+    EXPECT_TRUE((this->a_ * x).isApprox(this->b_.col(j), 1e-3));
+  }
+  EXPECT_NEAR(std::log(std::abs(this->a_.determinant())),
+              solver.LogDeterminant(), 1e-3);
+  EXPECT_TRUE(solver.IsInvertible());
+  EXPECT_GT(solver.ConditionEstimate(), 0);
+  EXPECT_LE(solver.ConditionEstimate(), 1);
+}
+
+TYPED_TEST(SolverTest, RectangularUsesLeastSquares) {
+  srand(0);
+  this->a_ = Nice::Matrix<TypeParam>::Random(30, 4);
+  this->b_ = Nice::Matrix<TypeParam>::Random(30, 2);
+  typename TestFixture::Solver solver(this->a_);
+  EXPECT_EQ(Nice::kQrFactorization, solver.GetFactorization());
+  Nice::Matrix<TypeParam> x = solver.Solve(this->b_);
+  // The residual is orthogonal to the columns of A
+  Nice::Matrix<TypeParam> normal =
+      this->a_.transpose() * (this->a_ * x - this->b_);
+  EXPECT_NEAR(0, normal.cwiseAbs().maxCoeff(), 1e-3);
+}
+
+TYPED_TEST(SolverTest, Singular) {
+  this->a_.setConstant(3, 3, 2);
+  typename TestFixture::Solver solver(this->a_, Nice::kLuFactorization);
+  EXPECT_FALSE(solver.IsInvertible());
+  EXPECT_NEAR(0, solver.ConditionEstimate(), 1e-6);
+}
+
+TYPED_TEST(SolverTest, NumericallySingular) {
+  // Rounding leaves no pivot exactly zero, but the rows are dependent
+  this->a_.resize(3, 3);
+  this->a_ << 1, 2, 3,
+              4, 5, 6,
+              7, 8, 9;
+  Nice::Factorization factorizations[] = {Nice::kLuFactorization,
+                                          Nice::kQrFactorization};
+  for (int f = 0; f < 2; f++) {
+    typename TestFixture::Solver solver(this->a_, factorizations[f]);
+    EXPECT_FALSE(solver.IsInvertible());
+    EXPECT_EQ(0, solver.ConditionEstimate());
+  }
+}
+
+TYPED_TEST(SolverTest, BadlyScaledIsInvertible) {
+  this->a_.setZero(2, 2);
+  this->a_(0, 0) = 1e-20;
+  this->a_(1, 1) = 1e20;
+  Nice::Factorization factorizations[] = {Nice::kCholeskyFactorization,
+                                          Nice::kLuFactorization};
+  for (int f = 0; f < 2; f++) {
+    typename TestFixture::Solver solver(this->a_, factorizations[f]);
+    EXPECT_TRUE(solver.IsInvertible());
+  }
+}
+
+TYPED_TEST(SolverTest, NonSquareLu) {
+  this->a_.setRandom(2, 3);
+  ASSERT_DEATH(typename TestFixture::Solver(this->a_, Nice::kLuFactorization),
+               ".*");
+}
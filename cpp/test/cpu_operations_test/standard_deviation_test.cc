@@ -23,6 +23,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <iostream>
+#include <vector>
 #include "Eigen/Dense"
 #include "gtest/gtest.h"
 #include "include/cpu_operations.h"
@@ -75,3 +76,46 @@ TYPED_TEST(MatrixStandardDeviationTest, BadAxis) {
              4, 5, 6;
   ASSERT_DEATH(this->MatrixStandardDeviation(2), ".*");
 }
+
+TYPED_TEST(MatrixStandardDeviationTest, LargeOffset) {
+  // Enough samples to be split across threads, on a large offset that a
+  // sum of squares would cancel
+  srand(0);
+  this->a = Nice::Matrix<TypeParam>::Random(1 << 18, 4).array() + 1000;
+  Nice::Matrix<double> centered = this->a.template cast<double>();
+  centered.rowwise() -= centered.colwise().mean();
+  Nice::Vector<double> expected =
+      (centered.colwise().squaredNorm() / this->a.rows()).cwiseSqrt();
+  this->MatrixStandardDeviation(0);
+  for (int j = 0; j < 4; j++)
+    EXPECT_NEAR(expected(j), this->answer(j), 1e-3);
+}
+
+TYPED_TEST(MatrixStandardDeviationTest, MeanVarianceRows) {
+  srand(0);
+  this->a = Nice::Matrix<TypeParam>::Random(5, 1000);
+  Nice::Vector<TypeParam> mean, variance;
+  Nice::CpuOperations<TypeParam>::MeanVariance(this->a, &mean, &variance, 1);
+  Nice::Matrix<TypeParam> centered =
+      this->a.colwise() - this->a.rowwise().mean();
+  EXPECT_TRUE(mean.isApprox(this->a.rowwise().mean(), this->precision));
+  EXPECT_TRUE(variance.isApprox(
+      centered.rowwise().squaredNorm() / this->a.cols(), this->precision));
+}
+
+TYPED_TEST(MatrixStandardDeviationTest, StreamingChunks) {
+  srand(0);
+  this->a = Nice::Matrix<TypeParam>::Random(300, 3);
+  Nice::RunningMeanVariance<TypeParam> stream;
+  std::vector<int> chunks = {1, 99, 0, 150, 50};
+  int row = 0;
+  for (int size : chunks) {
+    stream.Add(this->a.middleRows(row, size));
+    row += size;
+  }
+  EXPECT_EQ(300, stream.Count());
+  Nice::Vector<TypeParam> mean, variance;
+  Nice::CpuOperations<TypeParam>::MeanVariance(this->a, &mean, &variance);
+  EXPECT_TRUE(mean.isApprox(stream.Mean(), this->precision));
+  EXPECT_TRUE(variance.isApprox(stream.Variance(), this->precision));
+}
@@ -34,6 +34,7 @@
 
 #include <iostream>
 #include <cmath>
+#include <stdexcept>
 
 #include "Eigen/Dense"
 #include "gtest/gtest.h"
@@ -126,3 +127,101 @@ TYPED_TEST(CpuSvdSolverTest, RankTest) {
   EXPECT_EQ(5, rank);
 }
 
+TYPED_TEST(CpuSvdSolverTest, RankTallMatrix) {
+  // A 40 x 6 matrix of rank 3, against Eigen's own rank
+  srand(0);
+  Nice::Matrix<TypeParam> a = Nice::Matrix<TypeParam>::Random(40, 3) *
+                              Nice::Matrix<TypeParam>::Random(3, 6);
+  this->CreateTestData();
+  Nice::SvdSolver<TypeParam> svd_solver;
+  svd_solver.Compute(this->matrix_);
+  Nice::Vector<TypeParam> s = svd_solver.SingularValues();
+  EXPECT_EQ(Eigen::JacobiSVD<Nice::Matrix<TypeParam>>(a).rank(),
+            svd_solver.Rank(a));
+  EXPECT_EQ(3, svd_solver.Rank(a));
+  // The factors of the last Compute are kept
+  EXPECT_EQ(5, svd_solver.MatrixU().rows());
+  EXPECT_EQ(5, svd_solver.MatrixV().rows());
+  EXPECT_TRUE(s.isApprox(svd_solver.SingularValues()));
+}
+
+
+TYPED_TEST(CpuSvdSolverTest, ThinFactors) {
+  Nice::Matrix<TypeParam> a = Nice::Matrix<TypeParam>::Random(30, 8);
+  Nice::SvdAlgorithm algorithms[] = {Nice::kJacobiSvd, Nice::kBdcSvd};
+#if EIGEN_VERSION_AT_LEAST(3, 3, 0)
+  int num_algorithms = 2;
+#else
+  int num_algorithms = 1;
+#endif
+  for (int i = 0; i < num_algorithms; i++) {
+    Nice::SvdSolver<TypeParam> svd_solver;
+    svd_solver.SetAlgorithm(algorithms[i]);
+    svd_solver.SetThin(true);
+    svd_solver.Compute(a);
+    Nice::Matrix<TypeParam> u = svd_solver.MatrixU();
+    Nice::Matrix<TypeParam> v = svd_solver.MatrixV();
+    EXPECT_EQ(30, u.rows());
+    EXPECT_EQ(8, u.cols());
+    EXPECT_EQ(8, v.rows());
+    EXPECT_EQ(8, v.cols());
+    EXPECT_TRUE((u * svd_solver.SingularValues().asDiagonal() *
+                 v.transpose()).isApprox(a, 1e-4));
+  }
+}
+
+TYPED_TEST(CpuSvdSolverTest, Factors) {
+  this->CreateTestData();
+  Nice::SvdSolver<TypeParam> svd_solver;
+  svd_solver.SetFactors(false, true);
+  svd_solver.Compute(this->matrix_);
+  EXPECT_EQ(0, svd_solver.MatrixU().size());
+  EXPECT_EQ(5, svd_solver.MatrixV().rows());
+  for (int i = 0; i < this->row_; i++)
+    EXPECT_NEAR(this->s_(i), svd_solver.SingularValues()(i), 0.1);
+}
+
+TYPED_TEST(CpuSvdSolverTest, Randomized) {
+  // A 200 x 100 matrix of rank 5 plus small noise
+  srand(0);
+  Nice::Matrix<TypeParam> a =
+      Nice::Matrix<TypeParam>::Random(200, 5) *
+      Nice::Matrix<TypeParam>::Random(5, 100) +
+      Nice::Matrix<TypeParam>::Random(200, 100) / 1000;
+  Nice::SvdSolver<TypeParam> exact;
+  exact.Compute(a);
+  Nice::SvdSolver<TypeParam> svd_solver;
+  svd_solver.SetRandomized(5, 5, 1);
+  svd_solver.Compute(a);
+  Nice::Matrix<TypeParam> u = svd_solver.MatrixU();
+  Nice::Matrix<TypeParam> v = svd_solver.MatrixV();
+  Nice::Vector<TypeParam> s = svd_solver.SingularValues();
+  ASSERT_EQ(5, s.size());
+  EXPECT_EQ(200, u.rows());
+  EXPECT_EQ(5, u.cols());
+  EXPECT_EQ(100, v.rows());
+  EXPECT_EQ(5, v.cols());
+  for (int i = 0; i < 5; i++)
+    EXPECT_NEAR(exact.SingularValues()(i), s(i),
+                1e-3 * exact.SingularValues()(0));
+  EXPECT_TRUE((u.transpose() * u).isApprox(
+      Nice::Matrix<TypeParam>::Identity(5, 5), 1e-4));
+  EXPECT_LT((u * s.asDiagonal() * v.transpose() - a).norm(),
+            1e-2 * a.norm());
+}
+
+TYPED_TEST(CpuSvdSolverTest, RandomizedNeedsRank) {
+  Nice::Matrix<TypeParam> a = Nice::Matrix<TypeParam>::Random(20, 10);
+  Nice::SvdSolver<TypeParam> svd_solver;
+  EXPECT_THROW(svd_solver.SetRandomized(0), std::runtime_error);
+  EXPECT_THROW(svd_solver.SetRandomized(-1), std::runtime_error);
+  svd_solver.SetAlgorithm(Nice::kRandomizedSvd);
+  EXPECT_THROW(svd_solver.Compute(a), std::runtime_error);
+}
+
+#if !EIGEN_VERSION_AT_LEAST(3, 3, 0)
+TYPED_TEST(CpuSvdSolverTest, BdcNeedsEigen33) {
+  Nice::SvdSolver<TypeParam> svd_solver;
+  EXPECT_THROW(svd_solver.SetAlgorithm(Nice::kBdcSvd), std::runtime_error);
+}
+#endif
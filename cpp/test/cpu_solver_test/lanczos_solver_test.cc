@@ -0,0 +1,146 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Northeastern University
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <stdexcept>
+#include <vector>
+#include "Eigen/Dense"
+#include "Eigen/Sparse"
+#include "gtest/gtest.h"
+#include "include/lanczos_solver.h"
+#include "include/matrix.h"
+#include "include/vector.h"
+
+template<class T>
+class LanczosSolverTest : public ::testing::Test {
+ public:
+  Nice::Matrix<T> matrix_;
+  Nice::LanczosSolver<T> solver_;
+
+  // A symmetric matrix with eigenvalues 1, 2, ..., n
+  void CreateDense(int n) {
+    srand(0);
+    Eigen::HouseholderQR<Nice::Matrix<T>> qr(Nice::Matrix<T>::Random(n, n));
+    Nice::Matrix<T> q = qr.householderQ();
+    Nice::Vector<T> values = Nice::Vector<T>::LinSpaced(n, 1, n);
+    matrix_ = q * values.asDiagonal() * q.transpose();
+  }
+
+  // Checks the eigenpairs against a dense eigen decomposition, whose
+  // eigenvalues are sorted ascending
+  void ExpectEigenpairs(const Nice::Matrix<T> &dense, int k, bool largest,
+                        T tol) {
+    Eigen::SelfAdjointEigenSolver<Nice::Matrix<T>> eigen(dense);
+    Nice::Vector<T> values = solver_.Eigenvalues();
+    Nice::Matrix<T> vectors = solver_.Eigenvectors();
+    ASSERT_EQ(k, values.size());
+    ASSERT_EQ(k, vectors.cols());
+    int n = dense.rows();
+    for (int j = 0; j < k; j++)
+      EXPECT_NEAR(eigen.eigenvalues()(largest ? n - 1 - j : j), values(j),
+                  tol);
+    EXPECT_TRUE((vectors.transpose() * vectors).isApprox(
+        Nice::Matrix<T>::Identity(k, k), tol));
+    Nice::Vector<T> residuals =
+        (dense * vectors - vectors * values.asDiagonal()).colwise().norm();
+    for (int j = 0; j < k; j++)
+      EXPECT_NEAR(residuals(j), solver_.Residuals()(j), tol);
+  }
+};
+
+typedef ::testing::Types<float, double> MyTypes;
+TYPED_TEST_CASE(LanczosSolverTest, MyTypes);
+
+TYPED_TEST(LanczosSolverTest, Largest) {
+  this->CreateDense(80);
+  this->solver_.SetTolerance(1e-4);
+  this->solver_.Compute(this->matrix_, 4);
+  EXPECT_TRUE(this->solver_.Converged());
+  this->ExpectEigenpairs(this->matrix_, 4, true, 1e-2);
+}
+
+TYPED_TEST(LanczosSolverTest, Smallest) {
+  this->CreateDense(80);
+  this->solver_.SetTolerance(1e-4);
+  this->solver_.SetWhich(Nice::kSmallestEigenvalues);
+  this->solver_.Compute(this->matrix_, 3);
+  EXPECT_TRUE(this->solver_.Converged());
+  this->ExpectEigenpairs(this->matrix_, 3, false, 1e-2);
+}
+
+TYPED_TEST(LanczosSolverTest, Block) {
+  // Eigenvalues of multiplicity 2 at the top need a block of 2
+  int n = 60;
+  this->CreateDense(n);
+  Eigen::SelfAdjointEigenSolver<Nice::Matrix<TypeParam>> eigen(
+      this->matrix_);
+  Nice::Vector<TypeParam> values = eigen.eigenvalues();
+  values(n - 2) = values(n - 1);
+  values(n - 4) = values(n - 3);
+  Nice::Matrix<TypeParam> q = eigen.eigenvectors();
+  this->matrix_ = q * values.asDiagonal() * q.transpose();
+  this->solver_.SetTolerance(1e-4);
+  this->solver_.SetBlockSize(2);
+  this->solver_.Compute(this->matrix_, 4);
+  EXPECT_TRUE(this->solver_.Converged());
+  this->ExpectEigenpairs(this->matrix_, 4, true, 1e-2);
+}
+
+TYPED_TEST(LanczosSolverTest, Sparse) {
+  // The Laplacian of a path of n nodes
+  int n = 100;
+  std::vector<Eigen::Triplet<TypeParam>> triplets;
+  for (int i = 0; i + 1 < n; i++) {
+    triplets.push_back(Eigen::Triplet<TypeParam>(i, i + 1, -1));
+    triplets.push_back(Eigen::Triplet<TypeParam>(i + 1, i, -1));
+    triplets.push_back(Eigen::Triplet<TypeParam>(i, i, 1));
+    triplets.push_back(Eigen::Triplet<TypeParam>(i + 1, i + 1, 1));
+  }
+  Eigen::SparseMatrix<TypeParam> laplacian(n, n);
+  laplacian.setFromTriplets(triplets.begin(), triplets.end());
+  this->solver_.SetTolerance(1e-4);
+  this->solver_.Compute(laplacian, 3);
+  EXPECT_TRUE(this->solver_.Converged());
+  this->ExpectEigenpairs(Nice::Matrix<TypeParam>(laplacian), 3, true, 1e-2);
+}
+
+TYPED_TEST(LanczosSolverTest, MatrixFree) {
+  // A low rank operator x -> u (u^T x) that is never formed
+  int n = 200;
+  srand(0);
+  Nice::Matrix<TypeParam> u = Nice::Matrix<TypeParam>::Random(n, 3);
+  typename Nice::LanczosSolver<TypeParam>::Operator op =
+      [&u](const Nice::Matrix<TypeParam> &x, Nice::Matrix<TypeParam> *y) {
+        y->noalias() = u * (u.transpose() * x);
+      };
+  this->solver_.SetTolerance(1e-4);
+  this->solver_.SetBlockSize(3);
+  this->solver_.Compute(op, n, 3);
+  EXPECT_TRUE(this->solver_.Converged());
+  this->ExpectEigenpairs(u * u.transpose(), 3, true, 1e-1);
+  EXPECT_GT(this->solver_.GetNumOperations(), 0);
+}
+
+TYPED_TEST(LanczosSolverTest, TooManyEigenpairs) {
+  this->CreateDense(10);
+  this->solver_.SetNumLanczosVectors(6);
+  EXPECT_THROW(this->solver_.Compute(this->matrix_, 6), std::runtime_error);
+}
@@ -0,0 +1,138 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Northeastern University
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+#include "Eigen/Dense"
+#include "Eigen/Sparse"
+#include "gtest/gtest.h"
+#include "include/lobpcg_solver.h"
+#include "include/matrix.h"
+#include "include/vector.h"
+
+template<class T>
+class LobpcgSolverTest : public ::testing::Test {
+ public:
+  Nice::Matrix<T> matrix_;
+  Nice::LobpcgSolver<T> solver_;
+
+  // A symmetric matrix with eigenvalues 1, 2, ..., n
+  void CreateDense(int n) {
+    srand(0);
+    Eigen::HouseholderQR<Nice::Matrix<T>> qr(Nice::Matrix<T>::Random(n, n));
+    Nice::Matrix<T> q = qr.householderQ();
+    Nice::Vector<T> values = Nice::Vector<T>::LinSpaced(n, 1, n);
+    matrix_ = q * values.asDiagonal() * q.transpose();
+  }
+
+  // Checks the eigenpairs against a dense eigen decomposition
+  void ExpectSmallestEigenpairs(const Nice::Matrix<T> &dense, int k, T tol) {
+    Eigen::SelfAdjointEigenSolver<Nice::Matrix<T>> eigen(dense);
+    Nice::Vector<T> values = solver_.Eigenvalues();
+    Nice::Matrix<T> vectors = solver_.Eigenvectors();
+    ASSERT_EQ(k, values.size());
+    ASSERT_EQ(k, vectors.cols());
+    for (int j = 0; j < k; j++)
+      EXPECT_NEAR(eigen.eigenvalues()(j), values(j), tol);
+    EXPECT_TRUE((vectors.transpose() * vectors).isApprox(
+        Nice::Matrix<T>::Identity(k, k), tol));
+    Nice::Vector<T> residuals =
+        (dense * vectors - vectors * values.asDiagonal()).colwise().norm();
+    for (int j = 0; j < k; j++)
+      EXPECT_NEAR(residuals(j), solver_.Residuals()(j), tol);
+  }
+};
+
+typedef ::testing::Types<float, double> MyTypes;
+TYPED_TEST_CASE(LobpcgSolverTest, MyTypes);
+
+TYPED_TEST(LobpcgSolverTest, Dense) {
+  this->CreateDense(60);
+  this->solver_.Compute(this->matrix_, 4);
+  EXPECT_TRUE(this->solver_.Converged());
+  this->ExpectSmallestEigenpairs(this->matrix_, 4, 1e-2);
+}
+
+TYPED_TEST(LobpcgSolverTest, SparseLaplacian) {
+  // The Laplacian of a ring of two loosely connected cliques of 20 nodes
+  int n = 40;
+  std::vector<Eigen::Triplet<TypeParam>> triplets;
+  for (int i = 0; i < n; i++) {
+    for (int j = 0; j < n; j++) {
+      if (i != j && i / 20 == j / 20)
+        triplets.push_back(Eigen::Triplet<TypeParam>(i, j, -1));
+    }
+    triplets.push_back(Eigen::Triplet<TypeParam>(i, i, 19));
+  }
+  triplets.push_back(Eigen::Triplet<TypeParam>(0, 20, -0.1));
+  triplets.push_back(Eigen::Triplet<TypeParam>(20, 0, -0.1));
+  triplets.push_back(Eigen::Triplet<TypeParam>(0, 0, 0.1));
+  triplets.push_back(Eigen::Triplet<TypeParam>(20, 20, 0.1));
+  Eigen::SparseMatrix<TypeParam> laplacian(n, n);
+  laplacian.setFromTriplets(triplets.begin(), triplets.end());
+  this->solver_.Compute(laplacian, 2);
+  EXPECT_TRUE(this->solver_.Converged());
+  this->ExpectSmallestEigenpairs(Nice::Matrix<TypeParam>(laplacian), 2,
+                                 1e-2);
+}
+
+TYPED_TEST(LobpcgSolverTest, ToleranceTradesIterations) {
+  this->CreateDense(80);
+  this->solver_.SetTolerance(1e-1);
+  this->solver_.Compute(this->matrix_, 3);
+  int loose = this->solver_.GetNumIter();
+  EXPECT_TRUE(this->solver_.Converged());
+  EXPECT_LE(this->solver_.Residuals().maxCoeff(), 1e-1 * 3);
+  this->solver_.SetTolerance(1e-4);
+  this->solver_.Compute(this->matrix_, 3);
+  EXPECT_TRUE(this->solver_.Converged());
+  EXPECT_LT(loose, this->solver_.GetNumIter());
+}
+
+TYPED_TEST(LobpcgSolverTest, MaxIter) {
+  this->CreateDense(60);
+  this->solver_.SetTolerance(0);
+  this->solver_.SetMaxIter(3);
+  this->solver_.Compute(this->matrix_, 2);
+  EXPECT_EQ(3, this->solver_.GetNumIter());
+  EXPECT_FALSE(this->solver_.Converged());
+}
+
+TYPED_TEST(LobpcgSolverTest, TooManyEigenpairs) {
+  this->CreateDense(10);
+  EXPECT_THROW(this->solver_.Compute(this->matrix_, 4), std::runtime_error);
+}
+
+TYPED_TEST(LobpcgSolverTest, StartingBlock) {
+  this->CreateDense(60);
+  this->solver_.SetTolerance(1e-3);
+  this->solver_.Compute(this->matrix_, 3);
+  int cold = this->solver_.GetNumIter();
+  // Starting from a perturbation of the solution
+  Nice::Matrix<TypeParam> start = this->solver_.Eigenvectors() +
+      Nice::Matrix<TypeParam>::Random(60, 3) / 100;
+  this->solver_.Compute(this->matrix_, start);
+  EXPECT_TRUE(this->solver_.Converged());
+  EXPECT_LT(this->solver_.GetNumIter(), cold);
+  this->ExpectSmallestEigenpairs(this->matrix_, 3, 1e-2);
+}
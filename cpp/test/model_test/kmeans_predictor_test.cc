@@ -0,0 +1,129 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Northeastern University
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <stdio.h>
+#include <iostream>
+#include <vector>
+#include "Eigen/Dense"
+#include "gtest/gtest.h"
+#include "include/kmeans_predictor.h"
+#include "include/matrix.h"
+#include "include/vector.h"
+
+template<typename T>
+class KMeansPredictorTest : public ::testing::Test {
+ protected:
+  Nice::Matrix<T> centers_;
+  Nice::Matrix<T> data_;
+  std::vector<int> labels_;
+
+  void Setup(int d, int k, int n) {
+    centers_ = Nice::Matrix<T>::Random(d, k);
+    data_ = Nice::Matrix<T>::Random(n, d);
+    labels_.assign(n, -1);
+  }
+
+  // The closest center of row i by brute force
+  int Expected(int i) {
+    int closest;
+    (centers_.colwise() - data_.row(i).transpose())
+        .colwise().squaredNorm().minCoeff(&closest);
+    return closest;
+  }
+
+  // Labels the first n rows as one batch and checks that exactly those
+  // labels were written
+  void ExpectBatch(const Nice::KMeansPredictor<T> &predictor, int n) {
+    labels_.assign(data_.rows(), -1);
+    Nice::Matrix<T> batch = data_.topRows(n);
+    predictor.Predict(batch, labels_.data());
+    for (int i = 0; i < data_.rows(); i++)
+      EXPECT_EQ(i < n ? Expected(i) : -1, labels_[i]);
+  }
+};
+
+typedef ::testing::Types<float, double> FloatTypes;
+
+TYPED_TEST_CASE(KMeansPredictorTest, FloatTypes);
+
+TYPED_TEST(KMeansPredictorTest, MatchesBruteForce) {
+  this->Setup(5, 20, 300);
+  Nice::KMeansPredictor<TypeParam> predictor(this->centers_);
+  predictor.Predict(this->data_, this->labels_.data());
+  for (int i = 0; i < this->data_.rows(); i++)
+    EXPECT_EQ(this->Expected(i), this->labels_[i]);
+}
+
+TYPED_TEST(KMeansPredictorTest, MultiThreaded) {
+  this->Setup(3, 10, 1000);
+  Nice::KMeansPredictor<TypeParam> predictor(this->centers_);
+  predictor.SetNumThreads(4, 100);
+  predictor.Predict(this->data_, this->labels_.data());
+  for (int i = 0; i < this->data_.rows(); i++)
+    EXPECT_EQ(this->Expected(i), this->labels_[i]);
+}
+
+TYPED_TEST(KMeansPredictorTest, PredictOne) {
+  this->Setup(4, 8, 50);
+  Nice::KMeansPredictor<TypeParam> predictor(this->centers_);
+  for (int i = 0; i < this->data_.rows(); i++) {
+    Nice::Vector<TypeParam> point = this->data_.row(i).transpose();
+    TypeParam dist;
+    EXPECT_EQ(this->Expected(i), predictor.PredictOne(point.data(), &dist));
+    EXPECT_NEAR((this->centers_.col(this->Expected(i)) - point).squaredNorm(),
+                dist, 0.001);
+  }
+}
+
+TYPED_TEST(KMeansPredictorTest, RowMajorInput) {
+  this->Setup(6, 12, 130);
+  Eigen::Matrix<TypeParam, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+      row_major = this->data_;
+  Nice::KMeansPredictor<TypeParam> predictor(this->centers_);
+  predictor.Predict(row_major, this->labels_.data());
+  for (int i = 0; i < this->data_.rows(); i++)
+    EXPECT_EQ(this->Expected(i), this->labels_[i]);
+}
+
+TYPED_TEST(KMeansPredictorTest, BatchSizes) {
+  // Single rows, partial blocks and batches split over threads, whose
+  // last thread gets a partial block
+  this->Setup(16, 100, 1000);
+  Nice::KMeansPredictor<TypeParam> predictor(this->centers_);
+  int sizes[] = {1, 63, 64, 65, 100, 1000};
+  for (int n : sizes)
+    this->ExpectBatch(predictor, n);
+  predictor.SetNumThreads(3, 100);
+  for (int n : sizes)
+    this->ExpectBatch(predictor, n);
+}
+
+TYPED_TEST(KMeansPredictorTest, Hnsw) {
+  this->Setup(4, 500, 200);
+  Nice::KMeansPredictor<TypeParam> predictor(this->centers_);
+  predictor.UseHnsw(16, 100, 100);
+  predictor.Predict(this->data_, this->labels_.data());
+  int found = 0;
+  for (int i = 0; i < this->data_.rows(); i++)
+    found += this->Expected(i) == this->labels_[i];
+  EXPECT_GT(found, 190);
+}
@@ -23,6 +23,10 @@
 #include <stdio.h>
 #include <iostream>
 #include <memory>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <thread>  // NOLINT(build/c++11)
 #include "Eigen/Dense"
 #include "gtest/gtest.h"
 #include "include/kmeans.h"
@@ -31,6 +35,7 @@
 #include "include/vector.h"
 #include "include/kernel_types.h"
 #include "include/stop_watch.h"
+#include "test/blob_test_util.h"
 
 
 template<typename T>
@@ -62,6 +67,17 @@ class KMeansTest : public ::testing::Test {
     data_file_path_ = base_dir + file_name;
     data_ = Nice::util::FromFile<T>(data_file_path_, ",");
   }
+
+  // Generates k blobs of points_per_blob points in d dimensions
+  void SetupBlobs(int k, int points_per_blob, int d) {
+    k_ = k;
+    kmeans_ = std::make_shared<Nice::KMeans<T>>();
+    data_ = Nice::test::GenerateBlobs<T>(k, points_per_blob, d);
+  }
+
+  void ExpectBlobsRecovered(int points_per_blob) {
+    Nice::test::ExpectBlobsRecovered(labels_, k_, points_per_blob);
+  }
 };
 
 typedef ::testing::Types<float> FloatTypes;
@@ -80,3 +96,386 @@ TYPED_TEST(KMeansTest, CPU5_10_3) {
 //  this->labels_ = this->kmeans_->GetLabels();
 //  // std::cout << this->labels_ << std::endl;
 }
+
+// The tests on generated blobs run in both precisions
+template<typename T>
+class KMeansBlobTest : public KMeansTest<T> {};
+
+typedef ::testing::Types<float, double> BlobTypes;
+
+TYPED_TEST_CASE(KMeansBlobTest, BlobTypes);
+
+TYPED_TEST(KMeansBlobTest, FixedDimension) {
+  this->SetupBlobs(3, 20, 2);
+  this->kmeans_->Fit(this->data_, this->k_);
+  this->labels_ = this->kmeans_->GetLabels();
+  this->ExpectBlobsRecovered(20);
+}
+
+TYPED_TEST(KMeansBlobTest, DynamicDimension) {
+  this->SetupBlobs(3, 20, 24);
+  this->kmeans_->Fit(this->data_, this->k_);
+  this->labels_ = this->kmeans_->GetLabels();
+  this->ExpectBlobsRecovered(20);
+}
+
+TYPED_TEST(KMeansBlobTest, PredictMatchesLabels) {
+  this->SetupBlobs(4, 10, 5);
+  this->kmeans_->Fit(this->data_, this->k_);
+  this->labels_ = this->kmeans_->GetLabels();
+  Nice::Vector<TypeParam> predicted = this->kmeans_->Predict(this->data_);
+  EXPECT_TRUE(predicted.isApprox(this->labels_));
+}
+
+TYPED_TEST(KMeansBlobTest, FilterAlgorithm) {
+  this->SetupBlobs(8, 25, 3);
+  this->kmeans_->SetAlgorithm(Nice::kFilterKMeans);
+  this->kmeans_->Fit(this->data_, this->k_);
+  this->labels_ = this->kmeans_->GetLabels();
+  this->ExpectBlobsRecovered(25);
+  // The kd-tree Predict path must agree with the fitted labels
+  Nice::Vector<TypeParam> predicted = this->kmeans_->Predict(this->data_);
+  EXPECT_TRUE(predicted.isApprox(this->labels_));
+  this->kmeans_->SetAlgorithm(Nice::kLloydKMeans);
+  predicted = this->kmeans_->Predict(this->data_);
+  EXPECT_TRUE(predicted.isApprox(this->labels_));
+  // Centers published by Lloyd have no kd-tree until Predict builds one
+  this->kmeans_->Fit(this->data_, this->k_);
+  this->labels_ = this->kmeans_->GetLabels();
+  this->kmeans_->SetAlgorithm(Nice::kFilterKMeans);
+  predicted = this->kmeans_->Predict(this->data_);
+  EXPECT_TRUE(predicted.isApprox(this->labels_));
+}
+
+TYPED_TEST(KMeansBlobTest, BisectingAlgorithm) {
+  this->SetupBlobs(8, 25, 3);
+  this->kmeans_->SetAlgorithm(Nice::kBisectingKMeans);
+  this->kmeans_->SetNumThreads(4);
+  this->kmeans_->Fit(this->data_, this->k_);
+  this->labels_ = this->kmeans_->GetLabels();
+  this->ExpectBlobsRecovered(25);
+  // A full binary hierarchy over 8 leaves
+  EXPECT_EQ(15u, this->kmeans_->GetHierarchy().size());
+  EXPECT_EQ(15, this->kmeans_->GetHierarchyCenters().cols());
+  // Descending the hierarchy finds the right blob on separated data
+  Nice::Vector<TypeParam> predicted = this->kmeans_->Predict(this->data_);
+  EXPECT_TRUE(predicted.isApprox(this->labels_));
+}
+
+TYPED_TEST(KMeansBlobTest, BisectingLargestCluster) {
+  this->SetupBlobs(4, 30, 2);
+  this->kmeans_->SetAlgorithm(Nice::kBisectingKMeans);
+  this->kmeans_->SetBisectingStrategy(Nice::kBisectLargestCluster);
+  this->kmeans_->Fit(this->data_, this->k_);
+  this->labels_ = this->kmeans_->GetLabels();
+  this->ExpectBlobsRecovered(30);
+}
+
+TYPED_TEST(KMeansBlobTest, SelectWeightedIndex) {
+  // Equal weights are drawn alike and zero weights never
+  this->kmeans_ = std::make_shared<Nice::KMeans<TypeParam>>();
+  Nice::Vector<TypeParam> weights(4);
+  weights << 0, 1, 0, 1;
+  srand48(0);
+  int counts[4] = {0, 0, 0, 0};
+  for (int i = 0; i < 1000; i++)
+    counts[this->kmeans_->SelectWeightedIndex(weights)]++;
+  EXPECT_EQ(0, counts[0]);
+  EXPECT_EQ(0, counts[2]);
+  EXPECT_GT(counts[1], 400);
+  EXPECT_GT(counts[3], 400);
+}
+
+TYPED_TEST(KMeansBlobTest, KMeansPPSeedsMatchReference) {
+  // The seeds are those of a plain linear scan over the cumulative
+  // weights, drawn from the same random sequence
+  this->SetupBlobs(4, 50, 3);
+  Nice::Matrix<TypeParam> points = this->data_.transpose();
+  int n = points.cols();
+  srand48(7);
+  srand(7);
+  Nice::Matrix<TypeParam> seeds = this->kmeans_->KMeansPPSeeds(points, 20);
+  srand48(7);
+  srand(7);
+  Nice::Matrix<TypeParam> reference(points.rows(), 20);
+  reference.col(0) = points.col(rand() % n);
+  Nice::Vector<TypeParam> weights = (points.colwise() - reference.col(0))
+      .colwise().squaredNorm().transpose();
+  for (int c = 1; c < 20; c++) {
+    TypeParam total = 0;
+    for (int i = 0; i < n; i++)
+      total += weights(i);
+    TypeParam value = (TypeParam)drand48() * total;
+    TypeParam running = 0;
+    int selected = -1;
+    for (int i = 0; i < n && selected < 0; i++) {
+      running += weights(i);
+      if (value < running)
+        selected = i;
+    }
+    ASSERT_GE(selected, 0);
+    reference.col(c) = points.col(selected);
+    weights = weights.cwiseMin((points.colwise() - reference.col(c))
+                               .colwise().squaredNorm().transpose());
+  }
+  EXPECT_EQ(reference, seeds);
+}
+
+TYPED_TEST(KMeansBlobTest, InertiaMatchesSSE) {
+  this->SetupBlobs(5, 20, 3);
+  Nice::Matrix<TypeParam> points = this->data_.transpose();
+  this->kmeans_->Fit(this->data_, this->k_);
+  EXPECT_NEAR(this->kmeans_->GetSSE(points), this->kmeans_->GetInertia(),
+              0.001);
+  this->kmeans_->SetAlgorithm(Nice::kFilterKMeans);
+  this->kmeans_->Fit(this->data_, this->k_);
+  EXPECT_NEAR(this->kmeans_->GetSSE(points), this->kmeans_->GetInertia(),
+              0.001);
+  this->kmeans_->SetAlgorithm(Nice::kBisectingKMeans);
+  this->kmeans_->Fit(this->data_, this->k_);
+  EXPECT_NEAR(this->kmeans_->GetSSE(points), this->kmeans_->GetInertia(),
+              0.001);
+}
+
+TYPED_TEST(KMeansBlobTest, IterationLog) {
+  this->SetupBlobs(4, 25, 2);
+  this->kmeans_->SetNInit(3);
+  this->kmeans_->Fit(this->data_, this->k_);
+  const Nice::KMeansIterationLog<TypeParam> &log =
+      this->kmeans_->GetIterationLog();
+  ASSERT_GT(log.inertia.size(), 0u);
+  EXPECT_EQ(log.inertia.size(), log.round.size());
+  EXPECT_EQ(log.inertia.size(), log.reassigned.size());
+  EXPECT_EQ(log.inertia.size(), log.timer.vec_.size());
+  EXPECT_EQ(2u, log.round.back());
+  // Every restart ends with an iteration that reassigned nothing
+  EXPECT_EQ(0u, log.reassigned.back());
+  // The first iteration of a restart assigns every point
+  EXPECT_EQ(100u, log.reassigned.front());
+}
+
+TYPED_TEST(KMeansBlobTest, IterationLogReset) {
+  this->SetupBlobs(4, 25, 2);
+  this->kmeans_->SetNInit(3);
+  this->kmeans_->SweepK(this->data_, 2, 5);
+  const Nice::KMeansIterationLog<TypeParam> &log =
+      this->kmeans_->GetIterationLog();
+  // The log of the best k only, restarts numbered from 0 again
+  ASSERT_GT(log.inertia.size(), 0u);
+  EXPECT_EQ(0u, log.round.front());
+  EXPECT_EQ(2u, log.round.back());
+  EXPECT_EQ(100u, log.reassigned.front());
+  // A bisecting fit does not keep the log of the previous fit
+  this->kmeans_->SetAlgorithm(Nice::kBisectingKMeans);
+  this->kmeans_->Fit(this->data_, this->k_);
+  EXPECT_EQ(0u, log.inertia.size());
+  EXPECT_EQ(0u, log.timer.vec_.size());
+}
+
+TYPED_TEST(KMeansBlobTest, MaxIter) {
+  this->SetupBlobs(4, 25, 2);
+  this->kmeans_->SetNInit(1);
+  this->kmeans_->SetMaxIter(1);
+  this->kmeans_->Fit(this->data_, this->k_);
+  EXPECT_EQ(1u, this->kmeans_->GetIterationLog().inertia.size());
+  // The labels still match the returned centers after an early stop
+  this->labels_ = this->kmeans_->GetLabels();
+  Nice::Vector<TypeParam> predicted = this->kmeans_->Predict(this->data_);
+  EXPECT_TRUE(predicted.isApprox(this->labels_));
+  Nice::Matrix<TypeParam> points = this->data_.transpose();
+  EXPECT_NEAR(this->kmeans_->GetSSE(points), this->kmeans_->GetInertia(),
+              0.001);
+}
+
+TYPED_TEST(KMeansBlobTest, MinReassignFraction) {
+  this->SetupBlobs(4, 25, 2);
+  this->kmeans_->SetNInit(1);
+  // Nothing after the first assignment can reassign every point
+  this->kmeans_->SetMinReassignFraction(1.0);
+  this->kmeans_->Fit(this->data_, this->k_);
+  EXPECT_GE(2u, this->kmeans_->GetIterationLog().inertia.size());
+}
+
+TYPED_TEST(KMeansBlobTest, SweepK) {
+  this->SetupBlobs(4, 25, 2);
+  this->kmeans_->SetNumThreads(3);
+  Nice::KMeansSweepResult<TypeParam> result =
+      this->kmeans_->SweepK(this->data_, 2, 7);
+  ASSERT_EQ(6u, result.k.size());
+  EXPECT_EQ(2u, result.k[0]);
+  EXPECT_EQ(7u, result.k[5]);
+  EXPECT_EQ(4u, result.best_k);
+  // Well separated blobs leave a much smaller inertia at the true k
+  EXPECT_LT(result.inertia[2], result.inertia[1] / 10);
+  // The model is left fitted with the best k
+  this->labels_ = this->kmeans_->GetLabels();
+  this->ExpectBlobsRecovered(25);
+  EXPECT_EQ(4, this->kmeans_->GetCenters().cols());
+}
+
+TYPED_TEST(KMeansBlobTest, SweepKAfterBisecting) {
+  // Under kBisectingKMeans every k of the sweep is bisected, and the
+  // model keeps the hierarchy of the best k, whatever it was fitted with
+  this->SetupBlobs(4, 25, 2);
+  this->kmeans_->SetAlgorithm(Nice::kBisectingKMeans);
+  this->kmeans_->SetNumThreads(2);
+  for (int fitted = 0; fitted < 2; fitted++) {
+    if (fitted)
+      this->kmeans_->Fit(this->data_, 2);
+    Nice::KMeansSweepResult<TypeParam> result =
+        this->kmeans_->SweepK(this->data_, 3, 5);
+    EXPECT_EQ(4u, result.best_k);
+    EXPECT_EQ(7u, this->kmeans_->GetHierarchy().size());
+    this->labels_ = this->kmeans_->GetLabels();
+    Nice::Vector<TypeParam> predicted = this->kmeans_->Predict(this->data_);
+    EXPECT_TRUE(predicted.isApprox(this->labels_));
+  }
+}
+
+TYPED_TEST(KMeansBlobTest, SweepKBisectingError) {
+  // Two distinct points cannot be bisected into 3 clusters, and the fit
+  // that fails on a sweep thread fails the sweep
+  this->SetupBlobs(2, 5, 2);
+  this->data_.setZero();
+  this->data_.bottomRows(5).setOnes();
+  this->kmeans_->SetAlgorithm(Nice::kBisectingKMeans);
+  this->kmeans_->SetNumThreads(2);
+  EXPECT_THROW(this->kmeans_->SweepK(this->data_, 2, 3), std::runtime_error);
+}
+
+TYPED_TEST(KMeansBlobTest, SweepKSampledSilhouette) {
+  this->SetupBlobs(3, 30, 3);
+  this->kmeans_->SetSilhouetteSampleSize(40);
+  Nice::KMeansSweepResult<TypeParam> result =
+      this->kmeans_->SweepK(this->data_, 2, 5);
+  EXPECT_EQ(3u, result.best_k);
+  EXPECT_GT(result.silhouette[1], 0.8);
+}
+
+TYPED_TEST(KMeansBlobTest, PartialFit) {
+  this->SetupBlobs(3, 200, 2);
+  // Stream the blobs in shuffled batches of 30 points
+  std::vector<int> order(this->data_.rows());
+  for (unsigned int i = 0; i < order.size(); i++)
+    order[i] = i;
+  std::mt19937 rng(0);
+  std::shuffle(order.begin(), order.end(), rng);
+  Nice::Matrix<TypeParam> batch(30, 2);
+  for (unsigned int b = 0; b + 30 <= order.size(); b += 30) {
+    for (int i = 0; i < 30; i++)
+      batch.row(i) = this->data_.row(order[b + i]);
+    this->kmeans_->PartialFit(batch, this->k_);
+  }
+  this->labels_ = this->kmeans_->Predict(this->data_);
+  this->ExpectBlobsRecovered(200);
+  // Every center ends up close to the mean of its blob
+  Nice::Matrix<TypeParam> centers = this->kmeans_->GetCenters();
+  for (int c = 0; c < this->k_; c++) {
+    Nice::Vector<TypeParam> mean =
+        this->data_.middleRows(c * 200, 200).colwise().mean().transpose();
+    EXPECT_LT((centers.col(this->labels_(c * 200)) - mean).norm(), 0.3);
+  }
+}
+
+TYPED_TEST(KMeansBlobTest, PartialFitAfterRefit) {
+  this->SetupBlobs(3, 200, 2);
+  this->kmeans_->Fit(this->data_, this->k_);
+  this->kmeans_->PartialFit(this->data_.topRows(30), this->k_);
+  // Refit on 10 points per blob, the counts of the first fit are dropped
+  Nice::Matrix<TypeParam> small(30, 2);
+  for (int c = 0; c < this->k_; c++)
+    small.middleRows(c * 10, 10) = this->data_.middleRows(c * 200, 10);
+  this->kmeans_->Fit(small, this->k_);
+  Nice::Matrix<TypeParam> centers = this->kmeans_->GetCenters();
+  // A batch of the same points shifted by 1 moves every center halfway
+  Nice::Matrix<TypeParam> shifted = small.array() + 1;
+  this->kmeans_->PartialFit(shifted, this->k_);
+  Nice::Matrix<TypeParam> moved = this->kmeans_->GetCenters();
+  for (int c = 0; c < this->k_; c++)
+    for (int j = 0; j < 2; j++)
+      EXPECT_NEAR(centers(j, c) + 0.5, moved(j, c), 1e-4);
+}
+
+TYPED_TEST(KMeansBlobTest, PartialFitAfterBisecting) {
+  // After the stream drifts, Predict follows the published centers
+  // rather than the hierarchy of the bisecting fit
+  this->SetupBlobs(3, 100, 2);
+  this->kmeans_->SetAlgorithm(Nice::kBisectingKMeans);
+  this->kmeans_->Fit(this->data_, this->k_);
+  this->kmeans_->SetDecay(0.5);
+  Nice::Matrix<TypeParam> moved = this->data_;
+  for (int i = 0; i < 30; i++) {
+    moved.col(0).array() += 0.5;
+    this->kmeans_->PartialFit(moved, this->k_);
+  }
+  EXPECT_TRUE(this->kmeans_->GetHierarchy().empty());
+  Nice::Matrix<TypeParam> centers = this->kmeans_->GetCenters();
+  Nice::Vector<TypeParam> predicted = this->kmeans_->Predict(moved);
+  for (int i = 0; i < moved.rows(); i++) {
+    int closest;
+    (centers.colwise() - moved.row(i).transpose())
+        .colwise().squaredNorm().minCoeff(&closest);
+    EXPECT_EQ(closest, predicted(i));
+  }
+}
+
+TYPED_TEST(KMeansBlobTest, PartialFitDecayFollowsDrift) {
+  this->SetupBlobs(1, 100, 2);
+  this->kmeans_->SetDecay(0.5);
+  this->kmeans_->PartialFit(this->data_, 1);
+  // The stream moves away by 50 in every dimension
+  Nice::Matrix<TypeParam> moved = this->data_.array() + 50;
+  for (int i = 0; i < 20; i++)
+    this->kmeans_->PartialFit(moved, 1);
+  Nice::Vector<TypeParam> mean = moved.colwise().mean().transpose();
+  EXPECT_LT((this->kmeans_->GetCenters().col(0) - mean).norm(), 0.01);
+}
+
+TYPED_TEST(KMeansBlobTest, PartialFitReseedsDeadCenters) {
+  this->SetupBlobs(2, 50, 2);
+  this->kmeans_->SetReseedFraction(0.1);
+  // Start from two centers on the first blob only
+  this->kmeans_->PartialFit(this->data_.topRows(50), 2);
+  for (int i = 0; i < 5; i++)
+    this->kmeans_->PartialFit(this->data_, 2);
+  this->labels_ = this->kmeans_->Predict(this->data_);
+  this->ExpectBlobsRecovered(50);
+}
+
+TYPED_TEST(KMeansBlobTest, PartialFitErrors) {
+  this->SetupBlobs(3, 20, 2);
+  this->kmeans_->PartialFit(this->data_, this->k_);
+  Nice::Matrix<TypeParam> centers = this->kmeans_->GetCenters();
+  EXPECT_THROW(this->kmeans_->PartialFit(this->data_, 4),
+               std::runtime_error);
+  EXPECT_THROW(this->kmeans_->PartialFit(
+      Nice::Matrix<TypeParam>::Zero(10, 3), this->k_), std::runtime_error);
+  // Rejected batches leave the centers alone
+  EXPECT_EQ(centers, this->kmeans_->GetCenters());
+}
+
+TYPED_TEST(KMeansBlobTest, PredictDuringPartialFit) {
+  this->SetupBlobs(4, 50, 3);
+  this->kmeans_->PartialFit(this->data_, this->k_);
+  std::shared_ptr<Nice::KMeans<TypeParam>> kmeans = this->kmeans_;
+  Nice::Matrix<TypeParam> data = this->data_;
+  std::thread updater([kmeans, data]() {
+    for (int i = 0; i < 200; i++)
+      kmeans->PartialFit(data, 4);
+  });
+  for (int i = 0; i < 200; i++) {
+    Nice::Vector<TypeParam> predicted = this->kmeans_->Predict(this->data_);
+    EXPECT_GE(predicted.minCoeff(), 0);
+    EXPECT_LT(predicted.maxCoeff(), 4);
+  }
+  updater.join();
+}
+
+TYPED_TEST(KMeansBlobTest, HnswPredict) {
+  this->SetupBlobs(6, 20, 3);
+  this->kmeans_->Fit(this->data_, this->k_);
+  this->kmeans_->SetHnswPredict(8);
+  this->labels_ = this->kmeans_->GetLabels();
+  Nice::Vector<TypeParam> predicted = this->kmeans_->Predict(this->data_);
+  EXPECT_TRUE(predicted.isApprox(this->labels_));
+}
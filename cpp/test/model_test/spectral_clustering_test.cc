@@ -22,7 +22,10 @@
 
 #include <stdio.h>
 #include <iostream>
+#include <algorithm>
 #include <memory>
+#include <stdexcept>
+#include <vector>
 #include "Eigen/Dense"
 #include "gtest/gtest.h"
 #include "include/spectral_clustering.h"
@@ -31,6 +34,7 @@
 #include "include/vector.h"
 #include "include/kernel_types.h"
 #include "include/stop_watch.h"
+#include "test/blob_test_util.h"
 
 template<typename T>
 class SpectralClusteringTest : public ::testing::Test {
@@ -62,6 +66,29 @@ class SpectralClusteringTest : public ::testing::Test {
     std::cout << "data_file_path: " << data_file_path_ << std::endl;
     data_ = Nice::util::FromFile<T>(data_file_path_, ",");
   }
+
+  // Generates k blobs of points_per_blob points in d dimensions
+  void SetupBlobs(int k, int points_per_blob, int d) {
+    k_ = k;
+    spectralclustering_ = std::make_shared<Nice::SpectralClustering<T>>();
+    data_ = Nice::test::GenerateBlobs<T>(k, points_per_blob, d);
+  }
+
+  // Predicts points near the training blobs, and expects them to get the
+  // label of their blob
+  void ExpectPredictedBlobs(int points_per_blob) {
+    Nice::Matrix<T> points = data_ +
+        Nice::Matrix<T>::Random(data_.rows(), data_.cols()) / 10;
+    Nice::Matrix<T> predicted = spectralclustering_->Predict(points);
+    ASSERT_EQ(data_.rows(), predicted.rows());
+    for (int i = 0; i < data_.rows(); i++)
+      EXPECT_EQ(labels_((i / points_per_blob) * points_per_blob),
+                predicted(i));
+  }
+
+  void ExpectBlobsRecovered(int points_per_blob) {
+    Nice::test::ExpectBlobsRecovered(labels_, k_, points_per_blob);
+  }
 };
 
 typedef ::testing::Types<float> FloatTypes;
@@ -87,3 +114,291 @@ TYPED_TEST(SpectralClusteringTest, CPU5_10_3) {
 //    }
 //  }
 }
+
+TYPED_TEST(SpectralClusteringTest, Blobs) {
+  this->SetupBlobs(3, 20, 2);
+  this->spectralclustering_->Fit(this->data_, this->k_);
+  this->labels_ = this->spectralclustering_->GetLabels();
+  EXPECT_EQ(this->data_.rows(), this->labels_.rows());
+  this->ExpectBlobsRecovered(20);
+}
+
+TYPED_TEST(SpectralClusteringTest, DenseEigenSolver) {
+  this->SetupBlobs(3, 20, 2);
+  this->spectralclustering_->SetEigenSolver(Nice::kDenseEigenSolver);
+  this->labels_ = this->spectralclustering_->FitPredict(this->data_,
+                                                        this->k_);
+  this->ExpectBlobsRecovered(20);
+}
+
+TYPED_TEST(SpectralClusteringTest, EigenResiduals) {
+  this->SetupBlobs(3, 20, 2);
+  this->spectralclustering_->SetEigenTolerance(1e-3);
+  this->spectralclustering_->Fit(this->data_, this->k_);
+  Nice::Vector<TypeParam> residuals =
+      this->spectralclustering_->GetEigenResiduals();
+  Nice::Vector<TypeParam> values = this->spectralclustering_->GetEigenvalues();
+  ASSERT_EQ(this->k_, residuals.size());
+  for (int j = 0; j < this->k_; j++) {
+    EXPECT_LE(residuals(j), 1e-3 * std::max(TypeParam(1), values(j)));
+    EXPECT_NEAR(0, values(j), 1e-3);
+  }
+}
+
+TYPED_TEST(SpectralClusteringTest, SparseGraphs) {
+  Nice::SpectralGraph graphs[] = {Nice::kKnnGraph, Nice::kMutualKnnGraph,
+                                  Nice::kEpsilonGraph};
+  for (int g = 0; g < 3; g++) {
+    this->SetupBlobs(3, 40, 2);
+    this->spectralclustering_->SetGraph(graphs[g]);
+    this->spectralclustering_->SetEpsilon(1);
+    this->labels_ = this->spectralclustering_->FitPredict(this->data_,
+                                                          this->k_);
+    this->ExpectBlobsRecovered(40);
+  }
+}
+
+TYPED_TEST(SpectralClusteringTest, ParallelKnnGraph) {
+  this->SetupBlobs(3, 1200, 3);
+  this->spectralclustering_->SetGraph(Nice::kKnnGraph);
+  this->spectralclustering_->SetNumThreads(3);
+  this->labels_ = this->spectralclustering_->FitPredict(this->data_,
+                                                        this->k_);
+  this->ExpectBlobsRecovered(1200);
+}
+
+TYPED_TEST(SpectralClusteringTest, HnswKnnGraph) {
+  Nice::SpectralGraph graphs[] = {Nice::kKnnGraph, Nice::kMutualKnnGraph};
+  for (int g = 0; g < 2; g++) {
+    this->SetupBlobs(3, 30, 8);
+    this->spectralclustering_->SetGraph(graphs[g]);
+    this->spectralclustering_->SetHnswGraph(8);
+    this->labels_ = this->spectralclustering_->FitPredict(this->data_,
+                                                          this->k_);
+    this->ExpectBlobsRecovered(30);
+    // Predict finds the neighbours of new points in the same index
+    this->ExpectPredictedBlobs(30);
+  }
+}
+
+TYPED_TEST(SpectralClusteringTest, NormalizedLaplacians) {
+  Nice::SpectralLaplacian laplacians[] = {Nice::kSymmetricLaplacian,
+                                          Nice::kRandomWalkLaplacian};
+  for (int l = 0; l < 2; l++) {
+    this->SetupBlobs(3, 30, 2);
+    this->spectralclustering_->SetLaplacian(laplacians[l]);
+    this->labels_ = this->spectralclustering_->FitPredict(this->data_,
+                                                          this->k_);
+    this->ExpectBlobsRecovered(30);
+    // The normalized Laplacians have eigenvalues in [0, 2]
+    Nice::Vector<TypeParam> values =
+        this->spectralclustering_->GetEigenvalues();
+    for (int j = 0; j < this->k_; j++)
+      EXPECT_NEAR(0, values(j), 1e-3);
+    // And the same with a sparse graph
+    this->spectralclustering_->SetGraph(Nice::kKnnGraph);
+    this->labels_ = this->spectralclustering_->FitPredict(this->data_,
+                                                          this->k_);
+    this->ExpectBlobsRecovered(30);
+  }
+}
+
+TYPED_TEST(SpectralClusteringTest, PowerIteration) {
+  this->SetupBlobs(3, 30, 2);
+  this->spectralclustering_->SetEigenSolver(Nice::kPowerIteration);
+  this->labels_ = this->spectralclustering_->FitPredict(this->data_,
+                                                        this->k_);
+  this->ExpectBlobsRecovered(30);
+  EXPECT_EQ(0, this->spectralclustering_->GetEigenvalues().size());
+  this->spectralclustering_->SetGraph(Nice::kKnnGraph);
+  this->labels_ = this->spectralclustering_->FitPredict(this->data_,
+                                                        this->k_);
+  this->ExpectBlobsRecovered(30);
+}
+
+TYPED_TEST(SpectralClusteringTest, Landmarks) {
+  Nice::SpectralLandmarks landmarks[] = {Nice::kRandomLandmarks,
+                                         Nice::kKMeansLandmarks};
+  for (int l = 0; l < 2; l++) {
+    this->SetupBlobs(3, 200, 3);
+    this->spectralclustering_->SetGraph(Nice::kLandmarkGraph);
+    this->spectralclustering_->SetLandmarks(30, 3, landmarks[l]);
+    this->labels_ = this->spectralclustering_->FitPredict(this->data_,
+                                                          this->k_);
+    EXPECT_EQ(this->data_.rows(), this->labels_.rows());
+    this->ExpectBlobsRecovered(200);
+  }
+}
+
+TYPED_TEST(SpectralClusteringTest, KMeansLandmarksDuplicatePoints) {
+  // Every point appears twice, so there are fewer distinct points than
+  // the default 1000 landmarks or than 50
+  int num_landmarks[] = {1000, 50};
+  for (int l = 0; l < 2; l++) {
+    this->SetupBlobs(3, 40, 2);
+    for (int i = 1; i < this->data_.rows(); i += 2)
+      this->data_.row(i) = this->data_.row(i - 1);
+    this->spectralclustering_->SetGraph(Nice::kLandmarkGraph);
+    this->spectralclustering_->SetLandmarks(num_landmarks[l], 10);
+    this->labels_ = this->spectralclustering_->FitPredict(this->data_,
+                                                          this->k_);
+    this->ExpectBlobsRecovered(40);
+  }
+}
+
+TYPED_TEST(SpectralClusteringTest, TooFewLandmarks) {
+  this->SetupBlobs(3, 10, 2);
+  this->spectralclustering_->SetGraph(Nice::kLandmarkGraph);
+  this->spectralclustering_->SetLandmarks(2, 2);
+  EXPECT_THROW(this->spectralclustering_->Fit(this->data_, this->k_),
+               std::runtime_error);
+}
+
+TYPED_TEST(SpectralClusteringTest, NoNearestLandmarks) {
+  this->SetupBlobs(3, 10, 2);
+  EXPECT_THROW(this->spectralclustering_->SetLandmarks(10, 0),
+               std::runtime_error);
+  EXPECT_THROW(this->spectralclustering_->SetLandmarks(10, -1),
+               std::runtime_error);
+}
+
+TYPED_TEST(SpectralClusteringTest, Predict) {
+  this->SetupBlobs(3, 30, 2);
+  this->spectralclustering_->SetLaplacian(Nice::kUnnormalizedLaplacian);
+  this->labels_ = this->spectralclustering_->FitPredict(this->data_,
+                                                        this->k_);
+  this->ExpectPredictedBlobs(30);
+  Nice::SpectralLaplacian laplacians[] = {Nice::kSymmetricLaplacian,
+                                          Nice::kRandomWalkLaplacian};
+  for (int l = 0; l < 2; l++) {
+    this->spectralclustering_->SetLaplacian(laplacians[l]);
+    this->labels_ = this->spectralclustering_->FitPredict(this->data_,
+                                                          this->k_);
+    this->ExpectPredictedBlobs(30);
+  }
+  Nice::SpectralGraph graphs[] = {Nice::kKnnGraph, Nice::kEpsilonGraph,
+                                  Nice::kLandmarkGraph};
+  for (int g = 0; g < 3; g++) {
+    this->spectralclustering_->SetGraph(graphs[g]);
+    this->spectralclustering_->SetLandmarks(20, 3);
+    this->labels_ = this->spectralclustering_->FitPredict(this->data_,
+                                                          this->k_);
+    this->ExpectPredictedBlobs(30);
+  }
+  this->spectralclustering_->SetGraph(Nice::kKnnGraph);
+  this->spectralclustering_->SetEigenSolver(Nice::kPowerIteration);
+  this->labels_ = this->spectralclustering_->FitPredict(this->data_,
+                                                        this->k_);
+  this->ExpectPredictedBlobs(30);
+}
+
+TYPED_TEST(SpectralClusteringTest, PredictSymmetricNearbyBlobs) {
+  // Predicting the training points reproduces the fitted labels
+  this->SetupBlobs(3, 30, 2);
+  this->data_ /= 10;
+  this->spectralclustering_->SetSigma(0.1);
+  this->spectralclustering_->SetLaplacian(Nice::kSymmetricLaplacian);
+  this->labels_ = this->spectralclustering_->FitPredict(this->data_,
+                                                        this->k_);
+  this->ExpectBlobsRecovered(30);
+  Nice::Matrix<TypeParam> predicted =
+      this->spectralclustering_->Predict(this->data_);
+  for (int i = 0; i < this->data_.rows(); i++)
+    EXPECT_EQ(this->labels_(i), predicted(i));
+}
+
+TYPED_TEST(SpectralClusteringTest, PredictErrors) {
+  this->SetupBlobs(3, 10, 2);
+  EXPECT_THROW(this->spectralclustering_->Predict(this->data_),
+               std::runtime_error);
+  this->spectralclustering_->Fit(this->data_, this->k_);
+  EXPECT_THROW(this->spectralclustering_->Predict(
+      Nice::Matrix<TypeParam>::Zero(2, 3)), std::runtime_error);
+}
+
+TYPED_TEST(SpectralClusteringTest, PredictFollowsFittedGraph) {
+  // Predict uses the graph of the last fit, not the current setting
+  this->SetupBlobs(3, 30, 2);
+  this->spectralclustering_->SetGraph(Nice::kLandmarkGraph);
+  this->spectralclustering_->SetLandmarks(20, 3);
+  this->spectralclustering_->Fit(this->data_, this->k_);
+  this->spectralclustering_->SetGraph(Nice::kKnnGraph);
+  this->labels_ = this->spectralclustering_->FitPredict(this->data_,
+                                                        this->k_);
+  this->spectralclustering_->SetGraph(Nice::kLandmarkGraph);
+  this->ExpectPredictedBlobs(30);
+  // A graph fit has no points to predict from, even after landmarks
+  this->spectralclustering_->Fit(this->data_, this->k_);
+  Eigen::SparseMatrix<TypeParam> graph(this->data_.rows(),
+                                       this->data_.rows());
+  graph.setIdentity();
+  this->spectralclustering_->FitGraph(graph, this->k_);
+  EXPECT_THROW(this->spectralclustering_->Predict(this->data_),
+               std::runtime_error);
+}
+
+TYPED_TEST(SpectralClusteringTest, PredictFollowsFittedSettings) {
+  // Changing the settings after a fit does not change Predict
+  this->SetupBlobs(3, 30, 2);
+  Nice::Matrix<TypeParam> points = this->data_ +
+      Nice::Matrix<TypeParam>::Random(this->data_.rows(), 2) / 10;
+  Nice::SpectralGraph graphs[] = {Nice::kFullyConnectedGraph,
+                                  Nice::kKnnGraph, Nice::kEpsilonGraph,
+                                  Nice::kLandmarkGraph};
+  for (int g = 0; g < 4; g++) {
+    this->spectralclustering_ =
+        std::make_shared<Nice::SpectralClustering<TypeParam>>();
+    this->spectralclustering_->SetGraph(graphs[g]);
+    this->spectralclustering_->SetLaplacian(Nice::kSymmetricLaplacian);
+    this->spectralclustering_->SetLandmarks(20, 3);
+    this->spectralclustering_->Fit(this->data_, this->k_);
+    Nice::Matrix<TypeParam> predicted =
+        this->spectralclustering_->Predict(points);
+    this->spectralclustering_->SetLaplacian(Nice::kRandomWalkLaplacian);
+    this->spectralclustering_->SetEigenSolver(Nice::kPowerIteration);
+    this->spectralclustering_->SetSigma(5);
+    this->spectralclustering_->SetNumNeighbors(2);
+    this->spectralclustering_->SetEpsilon(0.1);
+    this->spectralclustering_->SetLandmarks(20, 1);
+    EXPECT_EQ(predicted, this->spectralclustering_->Predict(points));
+  }
+}
+
+TYPED_TEST(SpectralClusteringTest, Multilevel) {
+  this->SetupBlobs(3, 300, 2);
+  this->spectralclustering_->SetGraph(Nice::kKnnGraph);
+  this->spectralclustering_->SetMultilevel(60);
+  this->labels_ = this->spectralclustering_->FitPredict(this->data_,
+                                                        this->k_);
+  this->ExpectBlobsRecovered(300);
+  this->spectralclustering_->SetLaplacian(Nice::kSymmetricLaplacian);
+  this->labels_ = this->spectralclustering_->FitPredict(this->data_,
+                                                        this->k_);
+  this->ExpectBlobsRecovered(300);
+}
+
+TYPED_TEST(SpectralClusteringTest, FitGraph) {
+  // Three rings of 50 nodes, with a weak edge between consecutive rings
+  int n = 150;
+  std::vector<Eigen::Triplet<TypeParam>> triplets;
+  for (int i = 0; i < n; i++) {
+    int next = (i % 50 == 49) ? i - 49 : i + 1;
+    triplets.push_back(Eigen::Triplet<TypeParam>(i, next, 1));
+    triplets.push_back(Eigen::Triplet<TypeParam>(next, i, 1));
+  }
+  for (int c = 0; c + 1 < 3; c++) {
+    triplets.push_back(Eigen::Triplet<TypeParam>(c * 50, c * 50 + 50, 0.01));
+    triplets.push_back(Eigen::Triplet<TypeParam>(c * 50 + 50, c * 50, 0.01));
+  }
+  Eigen::SparseMatrix<TypeParam> graph(n, n);
+  graph.setFromTriplets(triplets.begin(), triplets.end());
+  this->k_ = 3;
+  this->spectralclustering_ =
+      std::make_shared<Nice::SpectralClustering<TypeParam>>();
+  this->spectralclustering_->SetMultilevel(30);
+  this->spectralclustering_->FitGraph(graph, this->k_);
+  this->labels_ = this->spectralclustering_->GetLabels();
+  this->ExpectBlobsRecovered(50);
+  EXPECT_THROW(this->spectralclustering_->Predict(
+      Nice::Matrix<TypeParam>::Zero(1, 2)), std::runtime_error);
+}
@@ -0,0 +1,138 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Northeastern University
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Run with mpirun -np 4 Nice_mpi_test
+
+#include <mpi.h>
+#include <algorithm>
+#include <vector>
+#include "Eigen/Dense"
+#include "gtest/gtest.h"
+#include "include/mpi_kmeans.h"
+#include "include/kmeans.h"
+#include "include/matrix.h"
+#include "include/vector.h"
+#include "test/blob_test_util.h"
+
+template<typename T>
+class MpiKMeansTest : public ::testing::Test {
+ protected:
+  int rank_;
+  int size_;
+  int k_;
+  int points_per_blob_;
+  Nice::Matrix<T> data_;
+  // The rows of data_ owned by this rank
+  std::vector<int> rows_;
+  Nice::Matrix<T> shard_;
+
+  virtual void SetUp() {
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank_);
+    MPI_Comm_size(MPI_COMM_WORLD, &size_);
+  }
+
+  // Every rank generates the same k well separated blobs, and keeps the
+  // rows i with i % num_shards == rank; ranks past num_shards get no rows
+  void SetupBlobs(int k, int points_per_blob, int d, int num_shards) {
+    k_ = k;
+    points_per_blob_ = points_per_blob;
+    data_ = Nice::test::GenerateBlobs<T>(k, points_per_blob, d);
+    rows_.clear();
+    for (int i = rank_; i < data_.rows() && rank_ < num_shards;
+         i += num_shards)
+      rows_.push_back(i);
+    shard_.resize(rows_.size(), d);
+    for (unsigned int i = 0; i < rows_.size(); i++)
+      shard_.row(i) = data_.row(rows_[i]);
+  }
+
+  // All the ranks hold the same centers, and the labels of all the rows
+  // recover the blobs
+  void ExpectBlobsRecovered(Nice::MpiKMeans<T> *kmeans) {
+    Nice::Matrix<T> centers = kmeans->GetCenters();
+    Nice::Matrix<T> root_centers = centers;
+    MPI_Bcast(root_centers.data(), root_centers.size(),
+              Nice::MpiType<T>::Get(), 0, MPI_COMM_WORLD);
+    EXPECT_TRUE(centers.isApprox(root_centers));
+    // Every row is owned by one rank, which contributes its label
+    Nice::Matrix<T> labels = kmeans->GetLabels();
+    Nice::Vector<int> local = Nice::Vector<int>::Constant(data_.rows(), -1);
+    Nice::Vector<int> global(data_.rows());
+    for (unsigned int i = 0; i < rows_.size(); i++)
+      local(rows_[i]) = labels(i);
+    MPI_Allreduce(local.data(), global.data(), global.size(), MPI_INT,
+                  MPI_MAX, MPI_COMM_WORLD);
+    Nice::test::ExpectBlobsRecovered(global, k_, points_per_blob_);
+  }
+};
+
+typedef ::testing::Types<float, double> MyTypes;
+TYPED_TEST_CASE(MpiKMeansTest, MyTypes);
+
+TYPED_TEST(MpiKMeansTest, RecoversBlobs) {
+  this->SetupBlobs(4, 50, 3, this->size_);
+  Nice::MpiKMeans<TypeParam> kmeans;
+  kmeans.Fit(this->shard_, this->k_);
+  this->ExpectBlobsRecovered(&kmeans);
+}
+
+TYPED_TEST(MpiKMeansTest, MatchesSingleProcess) {
+  this->SetupBlobs(5, 40, 4, this->size_);
+  Nice::MpiKMeans<TypeParam> kmeans;
+  kmeans.Fit(this->shard_, this->k_);
+  Nice::KMeans<TypeParam> single;
+  single.Fit(this->data_, this->k_);
+  EXPECT_NEAR(single.GetInertia(), kmeans.GetInertia(), 1e-3);
+}
+
+TYPED_TEST(MpiKMeansTest, EmptyShard) {
+  // The last rank holds no rows
+  this->SetupBlobs(3, 30, 2, std::max(this->size_ - 1, 1));
+  Nice::MpiKMeans<TypeParam> kmeans;
+  kmeans.Fit(this->shard_, this->k_);
+  this->ExpectBlobsRecovered(&kmeans);
+}
+
+TYPED_TEST(MpiKMeansTest, TooManyClusters) {
+  this->SetupBlobs(2, 1, 2, this->size_);
+  Nice::MpiKMeans<TypeParam> kmeans;
+  EXPECT_THROW(kmeans.Fit(this->shard_, 3), std::runtime_error);
+}
+
+int main(int argc, char **argv) {
+  MPI_Init(&argc, &argv);
+  ::testing::InitGoogleTest(&argc, argv);
+  // Only rank 0 reports
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  if (rank != 0) {
+    ::testing::TestEventListeners &listeners =
+        ::testing::UnitTest::GetInstance()->listeners();
+    delete listeners.Release(listeners.default_result_printer());
+  }
+  int result = RUN_ALL_TESTS();
+  // Fail on every rank if any of them failed
+  int failed = 0;
+  MPI_Allreduce(&result, &failed, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+  MPI_Finalize();
+  return failed;
+}
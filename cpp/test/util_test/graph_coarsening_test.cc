@@ -0,0 +1,98 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Northeastern University
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <vector>
+#include "Eigen/Dense"
+#include "Eigen/Sparse"
+#include "gtest/gtest.h"
+#include "include/graph_coarsening.h"
+#include "include/matrix.h"
+#include "include/vector.h"
+
+template<class T>
+class GraphCoarseningTest : public ::testing::Test {
+ public:
+  Eigen::SparseMatrix<T> graph_;
+
+  // A width x height grid graph with random edge weights
+  void CreateGrid(int width, int height) {
+    srand(0);
+    std::vector<Eigen::Triplet<T>> triplets;
+    for (int x = 0; x < width; x++) {
+      for (int y = 0; y < height; y++) {
+        int i = x * height + y;
+        if (x + 1 < width)
+          AddEdge(i, i + height, &triplets);
+        if (y + 1 < height)
+          AddEdge(i, i + 1, &triplets);
+      }
+    }
+    graph_.resize(width * height, width * height);
+    graph_.setFromTriplets(triplets.begin(), triplets.end());
+  }
+
+  void AddEdge(int i, int j, std::vector<Eigen::Triplet<T>> *triplets) {
+    T w = 1 + static_cast<T>(rand()) / RAND_MAX;  // NOLINT
+    triplets->push_back(Eigen::Triplet<T>(i, j, w));
+    triplets->push_back(Eigen::Triplet<T>(j, i, w));
+  }
+};
+
+typedef ::testing::Types<float, double> MyTypes;
+TYPED_TEST_CASE(GraphCoarseningTest, MyTypes);
+
+TYPED_TEST(GraphCoarseningTest, Levels) {
+  this->CreateGrid(40, 25);
+  Nice::GraphCoarsening<TypeParam> coarsening;
+  coarsening.Coarsen(this->graph_, 100);
+  ASSERT_GT(coarsening.NumLevels(), 2);
+  EXPECT_LE(coarsening.Graph(coarsening.NumLevels() - 1).rows(), 100);
+  for (int level = 0; level + 1 < coarsening.NumLevels(); level++) {
+    const Eigen::SparseMatrix<TypeParam> &fine =
+        level == 0 ? this->graph_ : coarsening.Graph(level);
+    const Eigen::SparseMatrix<TypeParam> &coarse =
+        coarsening.Graph(level + 1);
+    const Eigen::SparseMatrix<TypeParam> &p = coarsening.Prolongation(level);
+    ASSERT_EQ(fine.rows(), p.rows());
+    ASSERT_EQ(coarse.rows(), p.cols());
+    // Every node goes to one coarse node, of at most two nodes
+    Nice::Matrix<TypeParam> dense = p;
+    EXPECT_TRUE((dense.rowwise().sum().array() == 1).all());
+    EXPECT_TRUE((dense.colwise().sum().array() <= 2).all());
+    // Edge weights and degrees are summed
+    Nice::Vector<TypeParam> degrees =
+        fine * Nice::Vector<TypeParam>::Ones(fine.rows());
+    Nice::Vector<TypeParam> coarse_degrees =
+        coarse * Nice::Vector<TypeParam>::Ones(coarse.rows());
+    EXPECT_TRUE(coarse_degrees.isApprox(dense.transpose() * degrees,
+                                        1e-4));
+    EXPECT_TRUE(Nice::Matrix<TypeParam>(coarse).isApprox(
+        Nice::Matrix<TypeParam>(coarse).transpose()));
+  }
+}
+
+TYPED_TEST(GraphCoarseningTest, SmallGraph) {
+  this->CreateGrid(5, 5);
+  Nice::GraphCoarsening<TypeParam> coarsening;
+  coarsening.Coarsen(this->graph_, 100);
+  EXPECT_EQ(1, coarsening.NumLevels());
+}
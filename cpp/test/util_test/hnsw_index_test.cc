@@ -0,0 +1,102 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Northeastern University
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <stdio.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include "Eigen/Dense"
+#include "include/hnsw_index.h"
+#include "include/matrix.h"
+#include "include/vector.h"
+#include "gtest/gtest.h"
+
+template<class T>
+class HnswIndexTest : public ::testing::Test {
+ public:
+  Nice::Matrix<T> points;
+  Nice::Matrix<T> queries;
+};
+
+typedef ::testing::Types<float, double> MyTypes;
+TYPED_TEST_CASE(HnswIndexTest, MyTypes);
+
+TYPED_TEST(HnswIndexTest, Recall) {
+  this->points = Nice::Matrix<TypeParam>::Random(8, 2000);
+  this->queries = Nice::Matrix<TypeParam>::Random(8, 50);
+  Nice::HnswIndex<TypeParam> index(16, 100);
+  index.SetNumThreads(1);
+  index.Build(this->points);
+  EXPECT_GT(index.Recall(this->queries, 10), 0.9);
+  // A larger candidate list finds more of the true neighbours
+  index.SetEf(200);
+  EXPECT_GT(index.Recall(this->queries, 10), 0.97);
+}
+
+TYPED_TEST(HnswIndexTest, ParallelBuild) {
+  this->points = Nice::Matrix<TypeParam>::Random(4, 2000);
+  this->queries = Nice::Matrix<TypeParam>::Random(4, 50);
+  Nice::HnswIndex<TypeParam> index(12, 100);
+  index.SetNumThreads(4);
+  index.Build(this->points);
+  EXPECT_GT(index.Recall(this->queries, 5), 0.9);
+  // Level 0 keeps at most 2 m links per point
+  for (int i = 0; i < index.NumPoints(); i++)
+    EXPECT_LE(index.Links(i, 0).size(), 24u);
+}
+
+TYPED_TEST(HnswIndexTest, FindNearestOfIndexedPoints) {
+  this->points = Nice::Matrix<TypeParam>::Random(3, 500);
+  Nice::HnswIndex<TypeParam> index;
+  index.Build(this->points);
+  int found = 0;
+  for (int i = 0; i < this->points.cols(); i++) {
+    TypeParam dist;
+    Nice::Vector<TypeParam> point = this->points.col(i);
+    found += index.FindNearest(point, &dist) == i;
+  }
+  EXPECT_GT(found, 495);
+}
+
+TYPED_TEST(HnswIndexTest, SaveAndLoad) {
+  this->points = Nice::Matrix<TypeParam>::Random(5, 300);
+  this->queries = Nice::Matrix<TypeParam>::Random(5, 20);
+  Nice::HnswIndex<TypeParam> index(8, 50);
+  index.Build(this->points);
+  std::string file_name = "../test/data_for_test/test_hnsw_index.bin";
+  index.Save(file_name);
+  Nice::HnswIndex<TypeParam> loaded;
+  loaded.Load(file_name);
+  std::remove(file_name.c_str());
+  EXPECT_EQ(300, loaded.NumPoints());
+  EXPECT_EQ(5, loaded.Dimension());
+  for (int q = 0; q < this->queries.cols(); q++) {
+    std::vector<typename Nice::HnswIndex<TypeParam>::Neighbor> expected =
+        index.Search(this->queries.col(q).data(), 5);
+    std::vector<typename Nice::HnswIndex<TypeParam>::Neighbor> result =
+        loaded.Search(this->queries.col(q).data(), 5);
+    EXPECT_TRUE(expected == result);
+  }
+  EXPECT_THROW(loaded.Load("../test/data_for_test/no_such_index.bin"),
+               std::runtime_error);
+}
@@ -0,0 +1,134 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Northeastern University
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <stdio.h>
+#include <iostream>
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include "Eigen/Dense"
+#include "include/kd_tree.h"
+#include "include/matrix.h"
+#include "include/vector.h"
+#include "gtest/gtest.h"
+
+template<class T>
+class KdTreeTest : public ::testing::Test {
+ public:
+  Nice::Matrix<T> points;
+  Nice::Matrix<T> queries;
+};
+
+typedef ::testing::Types<float, double> MyTypes;
+TYPED_TEST_CASE(KdTreeTest, MyTypes);
+
+TYPED_TEST(KdTreeTest, NodeStatistics) {
+  this->points = Nice::Matrix<TypeParam>::Random(3, 100);
+  Nice::KdTree<TypeParam> tree(4);
+  tree.Build(this->points);
+  EXPECT_EQ(100, tree.NumPoints());
+  EXPECT_EQ(100, tree.Count(0));
+  for (int node = 0; node < tree.NumNodes(); node++) {
+    const typename Nice::KdTree<TypeParam>::Node &n = tree.GetNode(node);
+    Nice::Vector<TypeParam> sum = Nice::Vector<TypeParam>::Zero(3);
+    for (int i = n.begin; i < n.end; i++) {
+      EXPECT_TRUE(tree.Points().col(i) ==
+                  this->points.col(tree.Index(i)));
+      EXPECT_TRUE((tree.Points().col(i).array() >=
+                   tree.Lower().col(node).array()).all());
+      EXPECT_TRUE((tree.Points().col(i).array() <=
+                   tree.Upper().col(node).array()).all());
+      sum += tree.Points().col(i);
+    }
+    for (int j = 0; j < 3; j++)
+      EXPECT_NEAR(sum(j), tree.Sum()(j, node), 0.0001);
+    if (tree.IsLeaf(node))
+      EXPECT_LE(tree.Count(node), 4);
+    else
+      EXPECT_EQ(tree.Count(node),
+                tree.Count(n.left) + tree.Count(n.right));
+  }
+}
+
+TYPED_TEST(KdTreeTest, FindNearest) {
+  this->points = Nice::Matrix<TypeParam>::Random(2, 200);
+  this->queries = Nice::Matrix<TypeParam>::Random(2, 50);
+  Nice::KdTree<TypeParam> tree;
+  tree.Build(this->points);
+  for (int q = 0; q < this->queries.cols(); q++) {
+    int expected;
+    TypeParam expected_dist =
+        (this->points.colwise() - this->queries.col(q))
+        .colwise().squaredNorm().minCoeff(&expected);
+    TypeParam dist;
+    Nice::Vector<TypeParam> query = this->queries.col(q);
+    EXPECT_EQ(expected, tree.FindNearest(query, &dist));
+    EXPECT_NEAR(expected_dist, dist, 0.0001);
+  }
+}
+
+TYPED_TEST(KdTreeTest, FindKNearest) {
+  this->points = Nice::Matrix<TypeParam>::Random(3, 300);
+  this->queries = Nice::Matrix<TypeParam>::Random(3, 20);
+  Nice::KdTree<TypeParam> tree;
+  tree.Build(this->points);
+  std::vector<typename Nice::KdTree<TypeParam>::Neighbor> neighbors;
+  for (int q = 0; q < this->queries.cols(); q++) {
+    Nice::Vector<TypeParam> dist = (this->points.colwise() -
+        this->queries.col(q)).colwise().squaredNorm().transpose();
+    std::vector<std::pair<TypeParam, int>> expected;
+    for (int i = 0; i < dist.size(); i++)
+      expected.push_back(std::make_pair(dist(i), i));
+    std::sort(expected.begin(), expected.end());
+    tree.FindKNearest(this->queries.col(q).data(), 10, &neighbors);
+    ASSERT_EQ(10u, neighbors.size());
+    for (int i = 0; i < 10; i++) {
+      EXPECT_EQ(expected[i].second, neighbors[i].second);
+      EXPECT_NEAR(expected[i].first, neighbors[i].first, 0.0001);
+    }
+  }
+  // Fewer points than asked for
+  tree.FindKNearest(this->queries.col(0).data(), 500, &neighbors);
+  EXPECT_EQ(300u, neighbors.size());
+}
+
+TYPED_TEST(KdTreeTest, FindInRadius) {
+  this->points = Nice::Matrix<TypeParam>::Random(2, 300);
+  this->queries = Nice::Matrix<TypeParam>::Random(2, 20);
+  Nice::KdTree<TypeParam> tree;
+  tree.Build(this->points);
+  std::vector<typename Nice::KdTree<TypeParam>::Neighbor> neighbors;
+  for (int q = 0; q < this->queries.cols(); q++) {
+    Nice::Vector<TypeParam> dist = (this->points.colwise() -
+        this->queries.col(q)).colwise().squaredNorm().transpose();
+    tree.FindInRadius(this->queries.col(q).data(), 0.1, &neighbors);
+    std::vector<int> found;
+    for (unsigned int i = 0; i < neighbors.size(); i++)
+      found.push_back(neighbors[i].second);
+    std::sort(found.begin(), found.end());
+    std::vector<int> expected;
+    for (int i = 0; i < dist.size(); i++)
+      if (dist(i) <= 0.1)
+        expected.push_back(i);
+    EXPECT_EQ(expected, found);
+  }
+}